@@ -0,0 +1,213 @@
+// Collision microbenchmarks over seeded random shapes. Prints one JSON
+// object per run so results can be diffed between commits.
+//
+// usage: collision_bench [seed] [queries] [output.json]
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/collisions.hpp"
+
+namespace {
+  std::atomic<std::size_t> allocations{0};
+}
+
+// Counts heap allocations so queries that should stay off the heap can be checked
+void* operator new(std::size_t size) {
+  ++allocations;
+  if (void* p = std::malloc(size == 0 ? 1 : size)) return p;
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { ::operator delete(p); }
+
+namespace {
+
+  struct Result {
+    std::string name;
+    std::size_t queries;
+    double seconds;
+    std::size_t allocations;
+  };
+
+  struct ShapePair {
+    collision::ConvexPolygon shape1;
+    collision::ConvexPolygon shape2;
+    Vec4 rect1;
+    Vec4 rect2;
+  };
+
+  float sink = 0.f; // keeps the compiler from dropping the queries
+
+  collision::ConvexPolygon randomPolygon(std::mt19937& rng, Vec2 center) {
+    std::uniform_real_distribution<float> radius(5.f, 30.f);
+    std::uniform_real_distribution<float> angle(0.f, 6.2831853f);
+    std::uniform_int_distribution<int> count(3, 16);
+
+    float r = radius(rng);
+    std::vector<Vec2> points;
+    for (int i = count(rng); i > 0; --i) {
+      float a = angle(rng);
+      points.emplace_back(center.x + r * std::cos(a), center.y + r * std::sin(a));
+    }
+    return collision::ConvexPolygon{points};
+  }
+
+  // Second shape placed close enough that some of the pairs overlap, the
+  // output reports how many
+  std::vector<ShapePair> randomPairs(std::uint32_t seed, std::size_t count) {
+    std::mt19937 rng{seed};
+    std::uniform_real_distribution<float> position(0.f, 1000.f);
+    std::uniform_real_distribution<float> offset(-50.f, 50.f);
+    std::uniform_real_distribution<float> size(8.f, 64.f);
+
+    std::vector<ShapePair> pairs;
+    for (std::size_t i = 0; i < count; ++i) {
+      Vec2 center{position(rng), position(rng)};
+      Vec2 other = center + Vec2{offset(rng), offset(rng)};
+      auto shape1 = randomPolygon(rng, center);
+      auto shape2 = randomPolygon(rng, other);
+      Vec4 rect1{center.x, center.y, size(rng), size(rng)};
+      Vec4 rect2{other.x, other.y, size(rng), size(rng)};
+      pairs.push_back({shape1, shape2, rect1, rect2});
+    }
+    return pairs;
+  }
+
+  template<class F>
+  Result measure(char const* name, std::size_t queries, F query) {
+    auto allocationsBefore = allocations.load();
+    auto begin = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < queries; ++i) {
+      sink += query(i);
+    }
+    auto end = std::chrono::steady_clock::now();
+    auto allocated = allocations.load() - allocationsBefore;
+    return {name, queries, std::chrono::duration<double>(end - begin).count(), allocated};
+  }
+
+  void writeJson(std::ostream& out, std::uint32_t seed, std::size_t pairs, std::size_t overlapping,
+		 std::vector<Result> const& results) {
+    out << "{\n  \"seed\": " << seed << ",\n  \"pairs\": " << pairs
+	<< ",\n  \"overlapping_pairs\": " << overlapping << ",\n  \"benchmarks\": [\n";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+      auto const& r = results[i];
+      // a skipped benchmark reports zeros rather than nan, which isn't JSON
+      double queries = static_cast<double>(r.queries);
+      double perQuery = r.queries > 0 ? 1.0 / queries : 0.0;
+      out << "    {\"name\": \"" << r.name << "\""
+	  << ", \"queries\": " << r.queries
+	  << ", \"queries_per_sec\": " << (r.queries > 0 ? queries / r.seconds : 0.0)
+	  << ", \"ns_per_query\": " << r.seconds * 1e9 * perQuery
+	  << ", \"allocations_per_query\": " << static_cast<double>(r.allocations) * perQuery
+	  << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+  }
+
+}
+
+int main(int argc, char* argv[])
+{
+  std::uint32_t seed = argc > 1 ? static_cast<std::uint32_t>(std::stoul(argv[1])) : 42;
+  std::size_t queries = argc > 2 ? std::stoul(argv[2]) : 200000;
+
+  auto pairs = randomPairs(seed, 1024);
+  auto pair = [&](std::size_t i) -> ShapePair& { return pairs[i % pairs.size()]; };
+
+  std::vector<Vec2> directions;
+  std::mt19937 rng{seed};
+  std::uniform_real_distribution<float> angle(0.f, 6.2831853f);
+  for (std::size_t i = 0; i < pairs.size(); ++i) {
+    float a = angle(rng);
+    directions.emplace_back(std::cos(a), std::sin(a));
+  }
+
+  // simplices of the overlapping pairs, for timing EPA on its own
+  std::vector<std::size_t> overlapping;
+  std::vector<collision::Simplex> simplices;
+  for (std::size_t i = 0; i < pairs.size(); ++i) {
+    collision::ShapeView view1{pairs[i].shape1.points()};
+    collision::ShapeView view2{pairs[i].shape2.points()};
+    auto res = collision::GJK(view1, view2);
+    if (res.second) {
+      overlapping.push_back(i);
+      simplices.push_back(res.first);
+    }
+  }
+
+  std::vector<Result> results;
+
+  results.push_back(measure("support", queries, [&](std::size_t i) {
+	auto& p = pair(i);
+	collision::ShapeView view1{p.shape1.points()};
+	collision::ShapeView view2{p.shape2.points()};
+	return collision::support(view1, view2, directions[i % directions.size()]).x;
+      }));
+
+  results.push_back(measure("support_hill_climbing", queries, [&](std::size_t i) {
+	auto& p = pair(i);
+	return collision::support(p.shape1, p.shape2, directions[i % directions.size()]).x;
+      }));
+
+  results.push_back(measure("aabb", queries, [&](std::size_t i) {
+	auto& p = pair(i);
+	return collision::AABB(p.rect1, p.rect2).depth;
+      }));
+
+  results.push_back(measure("gjk_rects", queries, [&](std::size_t i) {
+	auto& p = pair(i);
+	return collision::GJK(p.rect1, p.rect2).second ? 1.f : 0.f;
+      }));
+
+  results.push_back(measure("gjk", queries, [&](std::size_t i) {
+	auto& p = pair(i);
+	return collision::GJK(collision::ShapeView{p.shape1.points()}, collision::ShapeView{p.shape2.points()}).second ? 1.f : 0.f;
+      }));
+
+  // no overlapping pair to start from: reported with 0 queries
+  results.push_back(measure("epa", overlapping.empty() ? 0 : queries, [&](std::size_t i) {
+	auto& p = pairs[overlapping[i % overlapping.size()]];
+	auto const& simplex = simplices[i % simplices.size()];
+	return collision::EPA(collision::ShapeView{p.shape1.points()}, collision::ShapeView{p.shape2.points()}, simplex).depth;
+      }));
+
+  results.push_back(measure("gjk_epa", queries, [&](std::size_t i) {
+	auto& p = pair(i);
+	return collision::collide(collision::ShapeView{p.shape1.points()}, collision::ShapeView{p.shape2.points()}).depth;
+      }));
+
+  results.push_back(measure("sat", queries, [&](std::size_t i) {
+	auto& p = pair(i);
+	return collision::SAT(collision::ShapeView{p.shape1.points()}, collision::ShapeView{p.shape2.points()}).depth;
+      }));
+
+  results.push_back(measure("mpr", queries, [&](std::size_t i) {
+	auto& p = pair(i);
+	return collision::MPR(collision::ShapeView{p.shape1.points()}, collision::ShapeView{p.shape2.points()}).depth;
+      }));
+
+  results.push_back(measure("gjk_distance", queries, [&](std::size_t i) {
+	auto& p = pair(i);
+	return collision::distance(collision::ShapeView{p.shape1.points()}, collision::ShapeView{p.shape2.points()}).distance;
+      }));
+
+  if (argc > 3) {
+    std::ofstream file{argv[3]};
+    writeJson(file, seed, pairs.size(), overlapping.size(), results);
+  } else {
+    writeJson(std::cout, seed, pairs.size(), overlapping.size(), results);
+  }
+
+  std::cerr << "checksum " << sink << "\n";
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,281 @@
+#ifndef AABB_TREE_H
+#define AABB_TREE_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "collisions.hpp"
+
+namespace broadphase {
+
+  // Dynamic bounding volume tree over fattened rects (x, y, width, height).
+  // Leaves store a rect grown by a margin, so an object moving a little
+  // stays inside its leaf and the tree is only touched when it leaves it.
+  // Inserts pick the sibling with the cheapest perimeter growth and the
+  // tree is kept balanced with AVL-style rotations.
+  class AABBTree {
+  public:
+    static constexpr int nullNode = -1;
+
+    explicit AABBTree(float fatMargin = 8.f) : margin(fatMargin) {}
+
+    // Returns the proxy used to move or remove the object later
+    int insert(std::size_t id, Vec4 rect) {
+      int proxy = allocateNode();
+      node(proxy).box = fatten(rect);
+      node(proxy).id = id;
+      node(proxy).height = 0;
+      insertLeaf(proxy);
+      return proxy;
+    }
+
+    void remove(int proxy) {
+      removeLeaf(proxy);
+      freeNode(proxy);
+    }
+
+    // Returns true when the rect left its fat box and the leaf was reinserted
+    bool move(int proxy, Vec4 rect) {
+      if (contains(node(proxy).box, rect)) return false;
+
+      removeLeaf(proxy);
+      node(proxy).box = fatten(rect);
+      insertLeaf(proxy);
+      return true;
+    }
+
+    Vec4 fatRect(int proxy) const { return node(proxy).box; }
+
+    // Appends the ids of every leaf whose fat box overlaps rect
+    void query(Vec4 rect, std::vector<std::size_t>& out) const {
+      if (root == nullNode) return;
+
+      stack.clear();
+      stack.push_back(root);
+      while (!stack.empty()) {
+	Node const& current = node(stack.back());
+	stack.pop_back();
+	if (!overlaps(current.box, rect)) continue;
+
+	if (current.isLeaf()) {
+	  out.push_back(current.id);
+	} else {
+	  stack.push_back(current.child1);
+	  stack.push_back(current.child2);
+	}
+      }
+    }
+
+    int height() const { return root == nullNode ? 0 : node(root).height; }
+
+  private:
+    struct Node {
+      bool isLeaf() const { return child1 == nullNode; }
+
+      Vec4 box;
+      std::size_t id{0};
+      int parent{nullNode}; // next free node while on the free list
+      int child1{nullNode};
+      int child2{nullNode};
+      int height{-1};
+    };
+
+    static Vec4 combine(Vec4 a, Vec4 b) {
+      float x = std::min(a.x, b.x);
+      float y = std::min(a.y, b.y);
+      return {x, y, std::max(a.x + a.z, b.x + b.z) - x, std::max(a.y + a.w, b.y + b.w) - y};
+    }
+
+    static float perimeter(Vec4 a) {
+      return 2.f * (a.z + a.w);
+    }
+
+    static bool contains(Vec4 outer, Vec4 inner) {
+      return outer.x <= inner.x && outer.y <= inner.y
+	&& inner.x + inner.z <= outer.x + outer.z
+	&& inner.y + inner.w <= outer.y + outer.w;
+    }
+
+    static bool overlaps(Vec4 a, Vec4 b) {
+      return a.x < b.x + b.z && b.x < a.x + a.z && a.y < b.y + b.w && b.y < a.y + a.w;
+    }
+
+    Node& node(int index) { return nodes[static_cast<std::size_t>(index)]; }
+    Node const& node(int index) const { return nodes[static_cast<std::size_t>(index)]; }
+
+    Vec4 fatten(Vec4 rect) const {
+      return {rect.x - margin, rect.y - margin, rect.z + 2 * margin, rect.w + 2 * margin};
+    }
+
+    int allocateNode() {
+      if (freeList == nullNode) {
+	nodes.emplace_back();
+	return static_cast<int>(nodes.size()) - 1;
+      }
+      int index = freeList;
+      freeList = node(index).parent;
+      node(index) = Node{};
+      return index;
+    }
+
+    void freeNode(int index) {
+      node(index).parent = freeList;
+      node(index).height = -1;
+      freeList = index;
+    }
+
+    void insertLeaf(int leaf) {
+      if (root == nullNode) {
+	root = leaf;
+	node(root).parent = nullNode;
+	return;
+      }
+
+      // walk down to the sibling that makes the tree grow the least
+      Vec4 leafBox = node(leaf).box;
+      int index = root;
+      while (!node(index).isLeaf()) {
+	Node const& current = node(index);
+	float area = perimeter(current.box);
+	float combinedArea = perimeter(combine(current.box, leafBox));
+
+	float cost = 2.f * combinedArea;
+	float inheritanceCost = 2.f * (combinedArea - area);
+
+	auto descendCost = [&](int child) {
+	  float grown = perimeter(combine(leafBox, node(child).box));
+	  if (node(child).isLeaf()) return grown + inheritanceCost;
+	  return grown - perimeter(node(child).box) + inheritanceCost;
+	};
+	float cost1 = descendCost(current.child1);
+	float cost2 = descendCost(current.child2);
+
+	if (cost < cost1 && cost < cost2) break;
+
+	index = cost1 < cost2 ? current.child1 : current.child2;
+      }
+
+      int sibling = index;
+      int oldParent = node(sibling).parent;
+      int newParent = allocateNode();
+      node(newParent).parent = oldParent;
+      node(newParent).box = combine(leafBox, node(sibling).box);
+      node(newParent).height = node(sibling).height + 1;
+      node(newParent).child1 = sibling;
+      node(newParent).child2 = leaf;
+      node(sibling).parent = newParent;
+      node(leaf).parent = newParent;
+
+      if (oldParent == nullNode) {
+	root = newParent;
+      } else if (node(oldParent).child1 == sibling) {
+	node(oldParent).child1 = newParent;
+      } else {
+	node(oldParent).child2 = newParent;
+      }
+
+      refit(node(leaf).parent);
+    }
+
+    void removeLeaf(int leaf) {
+      if (leaf == root) {
+	root = nullNode;
+	return;
+      }
+
+      int parent = node(leaf).parent;
+      int grandParent = node(parent).parent;
+      int sibling = node(parent).child1 == leaf ? node(parent).child2 : node(parent).child1;
+
+      if (grandParent == nullNode) {
+	root = sibling;
+	node(sibling).parent = nullNode;
+      } else {
+	if (node(grandParent).child1 == parent) {
+	  node(grandParent).child1 = sibling;
+	} else {
+	  node(grandParent).child2 = sibling;
+	}
+	node(sibling).parent = grandParent;
+      }
+      freeNode(parent);
+
+      refit(grandParent);
+    }
+
+    // Rebalances and recomputes boxes and heights from index up to the root
+    void refit(int index) {
+      while (index != nullNode) {
+	index = balance(index);
+
+	Node& current = node(index);
+	current.height = 1 + std::max(node(current.child1).height, node(current.child2).height);
+	current.box = combine(node(current.child1).box, node(current.child2).box);
+
+	index = current.parent;
+      }
+    }
+
+    // Rotates the taller child up when the children heights differ by more
+    // than one. Returns the node now standing where a was.
+    int balance(int a) {
+      if (node(a).isLeaf() || node(a).height < 2) return a;
+
+      int b = node(a).child1;
+      int c = node(a).child2;
+      int difference = node(c).height - node(b).height;
+
+      if (difference > 1) return rotate(a, c, b);
+      if (difference < -1) return rotate(a, b, c);
+      return a;
+    }
+
+    // Promotes child `up` of a in place of a; `other` stays under a
+    int rotate(int a, int up, int other) {
+      int f = node(up).child1;
+      int g = node(up).child2;
+
+      node(up).child1 = a;
+      node(up).parent = node(a).parent;
+      node(a).parent = up;
+
+      int upParent = node(up).parent;
+      if (upParent == nullNode) {
+	root = up;
+      } else if (node(upParent).child1 == a) {
+	node(upParent).child1 = up;
+      } else {
+	node(upParent).child2 = up;
+      }
+
+      // the taller grandchild stays with up, the shorter goes under a
+      int keep = node(f).height > node(g).height ? f : g;
+      int give = keep == f ? g : f;
+
+      node(up).child2 = keep;
+      if (node(a).child1 == up) {
+	node(a).child1 = give;
+      } else {
+	node(a).child2 = give;
+      }
+      node(give).parent = a;
+
+      node(a).box = combine(node(other).box, node(give).box);
+      node(up).box = combine(node(a).box, node(keep).box);
+      node(a).height = 1 + std::max(node(other).height, node(give).height);
+      node(up).height = 1 + std::max(node(a).height, node(keep).height);
+
+      return up;
+    }
+
+    std::vector<Node> nodes;
+    mutable std::vector<int> stack; // reused by query to stay allocation free
+    int root{nullNode};
+    int freeList{nullNode};
+    float margin;
+  };
+
+}
+
+#endif /* AABB_TREE_H */
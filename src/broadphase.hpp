@@ -0,0 +1,272 @@
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "aabb_tree.hpp"
+#include "collisions.hpp"
+#include "level.hpp"
+
+namespace broadphase {
+
+  enum class Type { Batch, Grid, SweepAndPrune, Tree };
+
+  // Parses the name given on the command line, keeping fallback for unknown names
+  Type parseType(std::string const& name, Type fallback) {
+    if (name == "batch") return Type::Batch;
+    if (name == "grid") return Type::Grid;
+    if (name == "sap") return Type::SweepAndPrune;
+    if (name == "tree") return Type::Tree;
+    return fallback;
+  }
+
+  // Spatial hash over a uniform grid. Each object index is stored in every
+  // cell its rect overlaps, so a query only looks at the cells under the
+  // query rect instead of every object in the level.
+  class UniformGrid {
+  public:
+    UniformGrid(float width, float height) : cellWidth(width), cellHeight(height) {}
+
+    void insert(std::size_t id, Vec4 rect) {
+      forEachCell(rect, [&](std::int64_t key) { cells[key].push_back(id); });
+    }
+
+    void remove(std::size_t id, Vec4 rect) {
+      forEachCell(rect, [&](std::int64_t key) { removeFromCell(key, id); });
+    }
+
+    // Only the cells the rect entered or left are touched, so a box sliding
+    // inside its cell costs nothing
+    void move(std::size_t id, Vec4 from, Vec4 to) {
+      CellRange before = cellRange(from);
+      CellRange after = cellRange(to);
+      if (before == after) return;
+
+      forEachCell(before, [&](std::int64_t key) {
+	  if (!after.contains(key)) removeFromCell(key, id);
+	});
+      forEachCell(after, [&](std::int64_t key) {
+	  if (!before.contains(key)) cells[key].push_back(id);
+	});
+    }
+
+    // Appends the ids of every object sharing a cell with rect, without duplicates
+    void query(Vec4 rect, std::vector<std::size_t>& out) const {
+      auto first = out.size();
+      forEachCell(rect, [&](std::int64_t key) {
+	  auto cell = cells.find(key);
+	  if (cell != cells.end())
+	    out.insert(out.end(), cell->second.begin(), cell->second.end());
+	});
+      auto begin = out.begin() + static_cast<std::ptrdiff_t>(first);
+      std::sort(begin, out.end());
+      out.erase(std::unique(begin, out.end()), out.end());
+    }
+
+    void clear() { cells.clear(); }
+
+  private:
+    struct CellRange {
+      std::int32_t minX, minY, maxX, maxY;
+
+      bool operator==(CellRange const& other) const {
+	return minX == other.minX && minY == other.minY && maxX == other.maxX && maxY == other.maxY;
+      }
+
+      bool contains(std::int64_t key) const {
+	auto x = cellX(key);
+	auto y = cellY(key);
+	return x >= minX && x <= maxX && y >= minY && y <= maxY;
+      }
+    };
+
+    static std::int64_t cellKey(std::int32_t x, std::int32_t y) {
+      return static_cast<std::int64_t>((static_cast<std::uint64_t>(static_cast<std::uint32_t>(x)) << 32)
+				       | static_cast<std::uint32_t>(y));
+    }
+
+    static std::int32_t cellX(std::int64_t key) {
+      return static_cast<std::int32_t>(static_cast<std::uint64_t>(key) >> 32);
+    }
+
+    static std::int32_t cellY(std::int64_t key) {
+      return static_cast<std::int32_t>(static_cast<std::uint64_t>(key) & 0xffffffffu);
+    }
+
+    // Right and bottom edges are exclusive: a tile-aligned rect sits in a
+    // single cell, since touching rects don't collide anyway
+    CellRange cellRange(Vec4 rect) const {
+      return {static_cast<std::int32_t>(std::floor(rect.x / cellWidth)),
+	      static_cast<std::int32_t>(std::floor(rect.y / cellHeight)),
+	      static_cast<std::int32_t>(std::ceil((rect.x + rect.z) / cellWidth)) - 1,
+	      static_cast<std::int32_t>(std::ceil((rect.y + rect.w) / cellHeight)) - 1};
+    }
+
+    template<class F>
+    static void forEachCell(CellRange range, F&& f) {
+      for (auto y = range.minY; y <= range.maxY; ++y) {
+	for (auto x = range.minX; x <= range.maxX; ++x) {
+	  f(cellKey(x, y));
+	}
+      }
+    }
+
+    template<class F>
+    void forEachCell(Vec4 rect, F&& f) const {
+      forEachCell(cellRange(rect), std::forward<F>(f));
+    }
+
+    void removeFromCell(std::int64_t key, std::size_t id) {
+      auto cell = cells.find(key);
+      if (cell == cells.end()) return;
+      auto& ids = cell->second;
+      auto it = std::find(ids.begin(), ids.end(), id);
+      if (it != ids.end()) {
+	*it = ids.back();
+	ids.pop_back();
+      }
+      if (ids.empty()) cells.erase(cell);
+    }
+
+    float cellWidth;
+    float cellHeight;
+    std::unordered_map<std::int64_t, std::vector<std::size_t>> cells;
+  };
+
+  // Incremental sort and sweep on the x axis. Bodies keep their order from
+  // one update to the next, so moving a body back into place only takes a
+  // handful of swaps when things move a little each frame.
+  class SweepAndPrune {
+  public:
+    void insert(std::size_t id, Vec4 rect) {
+      if (id >= bounds.size()) {
+	bounds.resize(id + 1);
+	present.resize(id + 1, false);
+	rank.resize(id + 1);
+      }
+      bounds[id] = rect;
+      widest = std::max(widest, rect.z);
+      if (!present[id]) {
+	present[id] = true;
+	rank[id] = order.size();
+	order.push_back(id);
+      }
+      reorder(id);
+    }
+
+    void remove(std::size_t id) {
+      if (id >= present.size() || !present[id]) return;
+      present[id] = false;
+      order.erase(order.begin() + static_cast<std::ptrdiff_t>(rank[id]));
+      for (auto i = rank[id]; i < order.size(); ++i) rank[order[i]] = i;
+    }
+
+    // Ignored for bodies that aren't in the sweep
+    void update(std::size_t id, Vec4 rect) {
+      if (id >= present.size() || !present[id]) return;
+      bounds[id] = rect;
+      widest = std::max(widest, rect.z);
+      reorder(id);
+    }
+
+    // Appends every pair of bodies whose rects overlap, lower id first
+    void pairs(std::vector<std::pair<std::size_t, std::size_t>>& out) const {
+      for (std::size_t i = 0; i < order.size(); ++i) {
+	Vec4 a = bounds[order[i]];
+	for (std::size_t j = i + 1; j < order.size(); ++j) {
+	  Vec4 b = bounds[order[j]];
+	  if (b.x >= a.x + a.z) break; // every later body starts further right
+	  if (b.y < a.y + a.w && a.y < b.y + b.w) {
+	    out.emplace_back(std::min(order[i], order[j]), std::max(order[i], order[j]));
+	  }
+	}
+      }
+    }
+
+    // Appends every body overlapping body id. Only bodies whose left edge
+    // lies within the widest rect of id's left edge can reach it.
+    void query(std::size_t id, std::vector<std::size_t>& out) const {
+      Vec4 a = bounds[id];
+      auto first = std::lower_bound(order.begin(), order.end(), a.x - widest,
+				    [&](std::size_t other, float x) { return bounds[other].x < x; });
+      for (auto it = first; it != order.end() && bounds[*it].x < a.x + a.z; ++it) {
+	Vec4 b = bounds[*it];
+	if (*it != id && a.x < b.x + b.z && b.y < a.y + a.w && a.y < b.y + b.w) out.push_back(*it);
+      }
+    }
+
+    std::size_t size() const { return order.size(); }
+
+  private:
+    // Insertion sort step for one body
+    void reorder(std::size_t id) {
+      auto i = rank[id];
+      for (; i > 0 && bounds[order[i - 1]].x > bounds[id].x; --i) {
+	order[i] = order[i - 1];
+	rank[order[i]] = i;
+      }
+      for (; i + 1 < order.size() && bounds[order[i + 1]].x < bounds[id].x; ++i) {
+	order[i] = order[i + 1];
+	rank[order[i]] = i;
+      }
+      order[i] = id;
+      rank[id] = i;
+    }
+
+    std::vector<Vec4> bounds;
+    std::vector<bool> present;
+    std::vector<std::size_t> order; // ids sorted on the left edge of their rect
+    std::vector<std::size_t> rank;  // id -> position in order
+    float widest{0.f};              // widest rect seen, never shrinks
+  };
+
+  // The builders use the index in objects as id, and the Level versions
+  // take level.objects
+
+  SweepAndPrune buildSweepAndPrune(std::vector<GameObject> const& objects) {
+    SweepAndPrune sap;
+    for (std::size_t i = 0; i < objects.size(); ++i) {
+      sap.insert(i, objects[i].rect);
+    }
+    return sap;
+  }
+
+  SweepAndPrune buildSweepAndPrune(Level const& level) {
+    return buildSweepAndPrune(level.objects);
+  }
+
+  // One cell per tile
+  UniformGrid buildGrid(std::vector<GameObject> const& objects) {
+    UniformGrid grid{constants::tile_width, constants::tile_height};
+    for (std::size_t i = 0; i < objects.size(); ++i) {
+      grid.insert(i, objects[i].rect);
+    }
+    return grid;
+  }
+
+  UniformGrid buildGrid(Level const& level) {
+    return buildGrid(level.objects);
+  }
+
+  // Objects go in once at load time
+  AABBTree buildTree(std::vector<GameObject> const& objects) {
+    AABBTree tree;
+    for (std::size_t i = 0; i < objects.size(); ++i) {
+      tree.insert(i, objects[i].rect);
+    }
+    return tree;
+  }
+
+  AABBTree buildTree(Level const& level) {
+    return buildTree(level.objects);
+  }
+
+}
+
+#endif /* BROADPHASE_H */
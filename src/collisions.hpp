@@ -1,6 +1,13 @@
 #ifndef COLLISIONS_H
 #define COLLISIONS_H
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <glm/glm.hpp>
@@ -12,7 +19,153 @@ using Vec2 = glm::vec2;
 using Vec3 = glm::vec3;
 using Vec4 = glm::vec4;
 
-std::size_t indexOfFurthestPoint(std::vector<Vec2> shape, Vec2 direction) {
+namespace collision {
+
+  // Non-owning view over the vertices of a convex shape, so narrowphase
+  // queries can run on vectors, arrays or raw buffers without copying them
+  struct ShapeView {
+    ShapeView(Vec2 const* first, std::size_t size, std::size_t* start = nullptr)
+      : points(first), count(size), hint(start) {}
+    ShapeView(std::vector<Vec2> const& shape) : points(shape.data()), count(shape.size()) {}
+    template<std::size_t N>
+    ShapeView(std::array<Vec2, N> const& shape) : points(shape.data()), count(N) {}
+
+    Vec2 const& operator[](std::size_t i) const { return points[i]; }
+    std::size_t size() const { return count; }
+
+    Vec2 const* points;
+    std::size_t count;
+    // Set when the vertices form a strictly convex ring: support queries
+    // then hill climb from this vertex and leave the best one in it
+    std::size_t* hint{nullptr};
+  };
+
+  // Fixed-capacity vertex storage, used for the GJK simplex and EPA polytope
+  // so that a query never touches the heap
+  template<std::size_t N>
+  struct VertexBuffer {
+    Vec2& operator[](std::size_t i) { return points[i]; }
+    Vec2 const& operator[](std::size_t i) const { return points[i]; }
+    std::size_t size() const { return count; }
+    static constexpr std::size_t capacity() { return N; }
+
+    bool insert(std::size_t index, Vec2 point) {
+      if (count >= N) return false;
+      for (std::size_t i = count; i > index; --i) {
+	points[i] = points[i - 1];
+      }
+      points[index] = point;
+      ++count;
+      return true;
+    }
+
+    operator ShapeView() const { return {points.data(), count}; }
+
+    std::array<Vec2, N> points{};
+    std::size_t count{0};
+  };
+
+  using Simplex = VertexBuffer<3>;
+
+  namespace detail {
+
+    // Scan of a fixed-size shape unrolled at compile time, one step per vertex
+    template<std::size_t I, std::size_t N>
+    struct FurthestPoint {
+      static void scan(std::array<Vec2, N> const& shape, Vec2 direction, float& maxProduct, std::size_t& index) {
+	float product = glm::dot(direction, shape[I]);
+	if (product > maxProduct) {
+	  maxProduct = product;
+	  index = I;
+	}
+	FurthestPoint<I + 1, N>::scan(shape, direction, maxProduct, index);
+      }
+    };
+
+    template<std::size_t N>
+    struct FurthestPoint<N, N> {
+      static void scan(std::array<Vec2, N> const&, Vec2, float&, std::size_t&) {}
+    };
+
+  }
+
+  // Convex polygon kept as a counter-clockwise ring without collinear
+  // vertices, so its support mapping can hill climb between neighbours
+  // instead of scanning every vertex. Meant for large decorative shapes.
+  class ConvexPolygon {
+  public:
+    // Builds the convex hull of the points (monotone chain)
+    explicit ConvexPolygon(std::vector<Vec2> points) {
+      std::sort(points.begin(), points.end(), [](Vec2 a, Vec2 b) {
+	  return a.x < b.x || (a.x == b.x && a.y < b.y);
+	});
+      points.erase(std::unique(points.begin(), points.end()), points.end());
+      if (points.size() < 3) {
+	vertices = points;
+	return;
+      }
+
+      auto cross = [](Vec2 o, Vec2 a, Vec2 b) {
+	return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+      };
+
+      vertices.resize(2 * points.size());
+      std::size_t k = 0;
+      for (std::size_t i = 0; i < points.size(); ++i) {
+	while (k >= 2 && cross(vertices[k - 2], vertices[k - 1], points[i]) <= 0) --k;
+	vertices[k++] = points[i];
+      }
+      for (std::size_t i = points.size() - 1, lower = k + 1; i > 0; --i) {
+	while (k >= lower && cross(vertices[k - 2], vertices[k - 1], points[i - 1]) <= 0) --k;
+	vertices[k++] = points[i - 1];
+      }
+      vertices.resize(k - 1);
+    }
+
+    std::vector<Vec2> const& points() const { return vertices; }
+
+    operator ShapeView() const { return {vertices.data(), vertices.size(), &hint}; }
+
+  private:
+    std::vector<Vec2> vertices;
+    mutable std::size_t hint{0}; // last support vertex
+  };
+
+}
+
+// Walks the ring from the hinted vertex towards increasing dot products.
+// On a strictly convex ring the first local maximum is the global one, and
+// coherent directions make this a couple of steps on average.
+std::size_t climbToFurthestPoint(collision::ShapeView shape, Vec2 direction) {
+  std::size_t n = shape.size();
+  std::size_t index = *shape.hint % n;
+  float maxProduct = glm::dot(direction, shape[index]);
+
+  std::size_t step = 1;
+  if (glm::dot(direction, shape[(index + 1) % n]) <= maxProduct) {
+    step = n - 1; // going backwards, modulo n
+    if (glm::dot(direction, shape[(index + step) % n]) <= maxProduct) {
+      *shape.hint = index;
+      return index;
+    }
+  }
+
+  for (std::size_t i = 1; i < n; ++i) {
+    std::size_t next = (index + step) % n;
+    float product = glm::dot(direction, shape[next]);
+    if (product <= maxProduct) break;
+    maxProduct = product;
+    index = next;
+  }
+
+  *shape.hint = index;
+  return index;
+}
+
+std::size_t indexOfFurthestPoint(collision::ShapeView shape, Vec2 direction) {
+  if (shape.hint && shape.size() > 3)
+    return climbToFurthestPoint(shape, direction);
+
   float maxProduct = glm::dot(direction, shape[0]);
   size_t index = 0;
   for (size_t i = 1; i < shape.size(); i++) {
@@ -25,14 +178,23 @@ std::size_t indexOfFurthestPoint(std::vector<Vec2> shape, Vec2 direction) {
   return index;
 }
 
-Vec2 averagePoint (std::vector<Vec2> points) {
+template<std::size_t N>
+std::size_t indexOfFurthestPoint(std::array<Vec2, N> const& shape, Vec2 direction) {
+  static_assert(N > 0, "shapes need at least one vertex");
+  float maxProduct = glm::dot(direction, shape[0]);
+  std::size_t index = 0;
+  collision::detail::FurthestPoint<1, N>::scan(shape, direction, maxProduct, index);
+  return index;
+}
+
+Vec2 averagePoint (collision::ShapeView points) {
   Vec2 avg = { 0.f, 0.f };
   for (size_t i = 0; i < points.size(); i++) {
     avg.x += points[i].x;
     avg.y += points[i].y;
   }
-  avg.x /= points.size();
-  avg.y /= points.size();
+  avg.x /= static_cast<float>(points.size());
+  avg.y /= static_cast<float>(points.size());
   return avg;
 }
 
@@ -47,12 +209,22 @@ Vec2 tripleProduct (Vec2 a, Vec2 b, Vec2 c) {
 
 namespace collision {
 
-  Vec2 support(std::vector<Vec2> shape1, std::vector<Vec2> shape2, Vec2 direction) {
+  Vec2 support(ShapeView shape1, ShapeView shape2, Vec2 direction) {
     std::size_t i = indexOfFurthestPoint(shape1, direction);
     std::size_t j = indexOfFurthestPoint(shape2, -direction);
 
     return shape1[i] - shape2[j];
   }
+
+  // Support of the Minkowski difference with shape1 translated by offset
+  Vec2 support(ShapeView shape1, ShapeView shape2, Vec2 direction, Vec2 offset) {
+    return support(shape1, shape2, direction) + offset;
+  }
+
+  template<std::size_t NA, std::size_t NB>
+  Vec2 support(std::array<Vec2, NA> const& shape1, std::array<Vec2, NB> const& shape2, Vec2 direction) {
+    return shape1[indexOfFurthestPoint(shape1, direction)] - shape2[indexOfFurthestPoint(shape2, -direction)];
+  }
   
   bool pointInRect(Vec2 point, Vec4 rect) {
 
@@ -62,126 +234,715 @@ namespace collision {
 	    && point.y <= rect.y + rect.w);
   }
   
-  std::pair<std::vector<Vec2>, bool> GJK(std::vector<Vec2> const& shape1, std::vector<Vec2> const& shape2) {
-    size_t index = 0; // index of current vertex of simplex
-    Vec2 a, b, c, d, ao, ab, ac, abperp, acperp;
-    std::vector<Vec2> simplex(3);
-    
-    Vec2 position1 = averagePoint (shape1); // not a CoG but
-    Vec2 position2 = averagePoint (shape2); // it's ok for GJK )
+  // Search direction GJK starts from and ends with, and how many support
+  // points it evaluated. Feeding the last direction back in warm starts
+  // the next query on the same pair.
+  struct GJKState {
+    Vec2 direction{0.f, 0.f};
+    std::size_t supports{0};
+  };
+
+  namespace detail {
+
+    // Shared by the runtime-sized and the fixed-size entry points, which only
+    // differ in the support function picked by overload resolution
+    template<class Shape1, class Shape2>
+    std::pair<Simplex, bool> GJK(Shape1 const& shape1, Shape2 const& shape2, GJKState& state) {
+      size_t index = 0; // index of current vertex of simplex
+      Vec2 a, b, c, d, ao, ab, ac, abperp, acperp;
+      Simplex simplex;
+
+      d = state.direction;
+      state.supports = 0;
 
-    // initial direction from the center of 1st body to the center of 2nd body
-    d = position1 - position2;
+      if ((d.x == 0) && (d.y == 0)) {
+	Vec2 position1 = averagePoint (shape1); // not a CoG but
+	Vec2 position2 = averagePoint (shape2); // it's ok for GJK )
+
+	// initial direction from the center of 1st body to the center of 2nd body
+	d = position1 - position2;
+      }
     
-    // if initial direction is zero – set it to any arbitrary axis (we choose X)
-    if ((d.x == 0) && (d.y == 0))
-      d.x = 1.f;
+      // if initial direction is zero – set it to any arbitrary axis (we choose X)
+      if ((d.x == 0) && (d.y == 0))
+	d.x = 1.f;
     
-    // set the first support as initial point of the new simplex
-    simplex[0] = support (shape1, shape2, d);
-    a = simplex[0];
+      // set the first support as initial point of the new simplex
+      simplex[0] = support (shape1, shape2, d);
+      simplex.count = 1;
+      ++state.supports;
+      a = simplex[0];
     
-    if (glm::dot(a, d) <= 0)
-      return {simplex, false}; // no collision
+      if (glm::dot(a, d) <= 0) {
+	state.direction = d; // separating axis
+	return {simplex, false}; // no collision
+      }
     
-    d = -a; // The next search direction is always towards the origin, so the next search direction is negate(a)
+      d = -a; // The next search direction is always towards the origin, so the next search direction is negate(a)
+
+      // When the origin lies on an edge of the Minkowski difference (shapes
+      // touching) rounding can make the simplex flip between two triangles
+      // forever. Every support point is a vertex of the difference, so a
+      // query that needs more than that is cycling: report the touch as no
+      // collision, like AABB does.
+      std::size_t maxSupports = 2 * (shape1.size() + shape2.size()) + 8;
     
-    while (true) {
+      while (state.supports < maxSupports) {
+        
+	a = simplex[++index] = support (shape1, shape2, d);
+	simplex.count = index + 1;
+	++state.supports;
         
-      a = simplex[++index] = support (shape1, shape2, d);
+	if (glm::dot(a, d) <= 0) {
+	  state.direction = d; // separating axis
+	  return{simplex, false}; // no collision
+	}
         
-      if (glm::dot(a, d) <= 0)
-	return{simplex, false}; // no collision
+	ao = -a; // from point A to Origin is just negative A
         
-      ao = -a; // from point A to Origin is just negative A
+	// simplex has 2 points (a line segment, not a triangle yet)
+	if (index < 2) {
+	  b = simplex[0];
+	  ab = b - a; // from point A to B
+	  d = tripleProduct (ab, ao, ab); // normal to AB towards Origin
+	  if (glm::length (d) == 0)
+	    d = [](Vec2 v) { Vec2 p = { v.y, -v.x }; return p; } (ab);
+	  continue; // skip to next iteration
+	}
         
-      // simplex has 2 points (a line segment, not a triangle yet)
-      if (index < 2) {
-	b = simplex[0];
+	b = simplex[1];
+	c = simplex[0];
 	ab = b - a; // from point A to B
-	d = tripleProduct (ab, ao, ab); // normal to AB towards Origin
-	if (glm::length (d) == 0)
-	  d = [](Vec2 v) { Vec2 p = { v.y, -v.x }; return p; } (ab);
-	continue; // skip to next iteration
-      }
-        
-      b = simplex[1];
-      c = simplex[0];
-      ab = b - a; // from point A to B
-      ac = c - a; // from point A to C
+	ac = c - a; // from point A to C
         
-      acperp = tripleProduct (ab, ac, ac);
+	acperp = tripleProduct (ab, ac, ac);
         
-      if (glm::dot(acperp, ao) >= 0) {
+	if (glm::dot(acperp, ao) >= 0) {
             
-	d = acperp; // new direction is normal to AC towards Origin
+	  d = acperp; // new direction is normal to AC towards Origin
             
-      } else {
+	} else {
             
-	abperp = tripleProduct (ac, ab, ab);
+	  abperp = tripleProduct (ac, ab, ab);
             
-	if (glm::dot (abperp, ao) < 0)
-	  return {simplex, true}; // collision
+	  if (glm::dot (abperp, ao) < 0) {
+	    state.direction = d;
+	    return {simplex, true}; // collision
+	  }
             
-	simplex[0] = simplex[1]; // swap first element (point C)
+	  simplex[0] = simplex[1]; // swap first element (point C)
 
-	d = abperp; // new direction is normal to AB towards Origin
-      }
+	  d = abperp; // new direction is normal to AB towards Origin
+	}
         
-      simplex[1] = simplex[2]; // swap element in the middle (point B)
-      --index;
-    }
+	simplex[1] = simplex[2]; // swap element in the middle (point B)
+	--index;
+	simplex.count = index + 1;
+      }
     
-    return {simplex, false};
+      state.direction = d;
+      return {simplex, false};
+    }
+
   }
 
-  std::pair<std::vector<Vec2>, bool> GJK(Vec4 shape1, Vec4 shape2) {
-    return GJK(std::vector<Vec2>{Vec2{shape1.x, shape1.y},
-				   Vec2{shape1.x + shape1.z, shape1.y},
-				     Vec2{shape1.x, shape1.y + shape1.w},
-				       Vec2{shape1.x + shape1.z, shape1.y + shape1.w}},
-      std::vector<Vec2>{Vec2{shape2.x, shape2.y},
-			  Vec2{shape2.x + shape2.z, shape2.y},
-			    Vec2{shape2.x, shape2.y + shape2.w},
-			      Vec2{shape2.x + shape2.z, shape2.y + shape2.w}});
+  std::pair<Simplex, bool> GJK(ShapeView shape1, ShapeView shape2, GJKState& state) {
+    return detail::GJK(shape1, shape2, state);
+  }
+
+  std::pair<Simplex, bool> GJK(ShapeView shape1, ShapeView shape2) {
+    GJKState state;
+    return GJK(shape1, shape2, state);
+  }
+
+  // Fixed vertex counts, mostly quads: the support scans unroll completely
+  template<std::size_t NA, std::size_t NB>
+  std::pair<Simplex, bool> GJK(std::array<Vec2, NA> const& shape1, std::array<Vec2, NB> const& shape2, GJKState& state) {
+    return detail::GJK(shape1, shape2, state);
+  }
+
+  template<std::size_t NA, std::size_t NB>
+  std::pair<Simplex, bool> GJK(std::array<Vec2, NA> const& shape1, std::array<Vec2, NB> const& shape2) {
+    GJKState state;
+    return detail::GJK(shape1, shape2, state);
+  }
+
+  std::pair<std::vector<Vec2>, bool> GJK(std::vector<Vec2> const& shape1, std::vector<Vec2> const& shape2) {
+    auto res = GJK(ShapeView{shape1}, ShapeView{shape2});
+    return {std::vector<Vec2>(res.first.points.data(), res.first.points.data() + res.first.size()), res.second};
   }
 
-  std::pair<Vec2, float> EPA(std::vector<Vec2> const& shape1, std::vector<Vec2> const& shape2, std::vector<Vec2> simplex) {	 
-    bool iterations = true;
-    while (iterations) {	    
-      int closestIndex = -1;
+  std::array<Vec2, 4> rectToPoints(Vec4 rect) {
+    return {{Vec2{rect.x, rect.y},
+	     Vec2{rect.x + rect.z, rect.y},
+	     Vec2{rect.x + rect.z, rect.y + rect.w},
+	     Vec2{rect.x, rect.y + rect.w}}};
+  }
+
+  std::pair<Simplex, bool> GJK(Vec4 shape1, Vec4 shape2) {
+    return GJK(rectToPoints(shape1), rectToPoints(shape2));
+  }
+
+  using Polytope = VertexBuffer<32>;
+
+  struct Penetration {
+    Vec2 normal{0.f, 0.f};
+    float depth{0.f};
+    std::size_t iterations{0};
+    bool converged{false};
+  };
+
+  // Expands the polytope towards the closest edge of the Minkowski difference
+  // until the new support point is within tolerance of that edge. Stops early
+  // with converged == false when it runs out of iterations or polytope room.
+  Penetration EPA(ShapeView shape1, ShapeView shape2, Polytope polytope,
+		  std::size_t maxIterations = 32, float tolerance = 1e-3f) {
+    Penetration result;
+    if (polytope.size() < 3)
+      return result;
+
+    // outward edge normals only depend on the winding, which inserting
+    // support points between two vertices never changes
+    float winding = 0.f;
+    for (std::size_t i = 0; i < polytope.size(); ++i) {
+      Vec2 a = polytope[i];
+      Vec2 b = polytope[(i + 1) % polytope.size()];
+      winding += a.x * b.y - a.y * b.x;
+    }
+    if (winding == 0.f)
+      return result; // degenerate simplex, shapes are only touching
+
+    while (result.iterations < maxIterations) {
+      ++result.iterations;
+
+      std::size_t closestIndex = 0;
       Vec2 closestNormal;
       float closestDistance = std::numeric_limits<float>::max();
-	  
-      for (std::size_t i = 0; i < simplex.size(); ++i) {
-	Vec2 a = simplex[i];
-	Vec2 b = i >= simplex.size()-1 ? simplex[0] : simplex[i+1];
+
+      for (std::size_t i = 0; i < polytope.size(); ++i) {
+	Vec2 a = polytope[i];
+	Vec2 b = polytope[(i + 1) % polytope.size()];
 	Vec2 e = b - a;
-	Vec2 oa = a;
-	Vec2 n = tripleProduct(e, oa, e);
-	n = glm::normalize(n);
+	Vec2 n = winding > 0 ? Vec2{e.y, -e.x} : Vec2{-e.y, e.x};
+	float length = glm::length(n);
+	if (length == 0.f)
+	  continue; // duplicated vertex
+	n /= length;
 	float d = glm::dot(a, n);
 
-	if (d < closestDistance && !std::isnan(d)) {
+	if (d < closestDistance) {
 	  closestNormal = n;
 	  closestDistance = d;
-	  closestIndex = (i+1) % simplex.size();
+	  closestIndex = i + 1;
 	}
       }
 
+      result.normal = closestNormal;
+      result.depth = closestDistance;
+
       Vec2 p = collision::support(shape1, shape2, closestNormal);
       float dist = glm::dot(p, closestNormal);
-      constexpr float epsilon = std::numeric_limits<float>::epsilon();
-	    
-      if (dist > -epsilon && dist < epsilon) {
-	iterations = false;
+
+      if (dist - closestDistance < tolerance) {
+	result.depth = dist;
+	result.converged = true;
+	break;
+      }
+
+      if (!polytope.insert(closestIndex, p))
+	break;
+    }
+
+    return result;
+  }
+
+  Penetration EPA(ShapeView shape1, ShapeView shape2, Simplex const& simplex) {
+    Polytope polytope;
+    for (std::size_t i = 0; i < simplex.size(); ++i) {
+      polytope.insert(i, simplex[i]);
+    }
+    return EPA(shape1, shape2, polytope);
+  }
+
+  Penetration EPA(ShapeView shape1, ShapeView shape2, std::vector<Vec2> const& simplex) {
+    Polytope polytope;
+    for (std::size_t i = 0; i < simplex.size() && i < Polytope::capacity(); ++i) {
+      polytope.insert(i, simplex[i]);
+    }
+    return EPA(shape1, shape2, polytope);
+  }
+
+
+  // Outcome of a collision query. The normal follows the EPA convention:
+  // moving shape1 by -normal * depth separates the two shapes.
+  struct Contact {
+    bool collides{false};
+    Vec2 normal{0.f, 0.f};
+    float depth{0.f};
+  };
+
+  Vec4 boundingRect(ShapeView shape) {
+    Vec2 lo = shape[0];
+    Vec2 hi = shape[0];
+    for (std::size_t i = 1; i < shape.size(); ++i) {
+      lo = glm::min(lo, shape[i]);
+      hi = glm::max(hi, shape[i]);
+    }
+    return {lo.x, lo.y, hi.x - lo.x, hi.y - lo.y};
+  }
+
+  // Analytic penetration between two axis-aligned rects (x, y, width, height).
+  // Touching rects don't collide, same as GJK.
+  Contact AABB(Vec4 rect1, Vec4 rect2) {
+    // how far rect1 has to move left/right (up/down) to clear rect2
+    float left = rect1.x + rect1.z - rect2.x;
+    float right = rect2.x + rect2.z - rect1.x;
+    float up = rect1.y + rect1.w - rect2.y;
+    float down = rect2.y + rect2.w - rect1.y;
+
+    if (left <= 0 || right <= 0 || up <= 0 || down <= 0)
+      return {};
+
+    // push along the axis of least penetration
+    float depthX = std::min(left, right);
+    float depthY = std::min(up, down);
+    if (depthX < depthY)
+      return {true, Vec2{left < right ? 1.f : -1.f, 0.f}, depthX};
+    return {true, Vec2{0.f, up < down ? 1.f : -1.f}, depthY};
+  }
+
+  // Rects take the analytic path, anything else goes through GJK + EPA
+  Contact collide(Vec4 rect1, Vec4 rect2) {
+    return AABB(rect1, rect2);
+  }
+
+  Contact collide(ShapeView shape1, ShapeView shape2) {
+    auto res = GJK(shape1, shape2);
+    if (!res.second)
+      return {};
+    auto penetration = EPA(shape1, shape2, res.first);
+    if (penetration.depth <= 0)
+      return {};
+    return {true, penetration.normal, penetration.depth};
+  }
+
+
+  // Position along segment [a, b] of its point closest to the origin, in [0, 1]
+  float closestParameterToOrigin(Vec2 a, Vec2 b) {
+    Vec2 ab = b - a;
+    float lengthSquared = glm::dot(ab, ab);
+    if (lengthSquared == 0.f)
+      return 0.f;
+    return glm::clamp(-glm::dot(a, ab) / lengthSquared, 0.f, 1.f);
+  }
+
+  // Point of segment [a, b] closest to the origin
+  Vec2 closestPointToOrigin(Vec2 a, Vec2 b) {
+    return a + (b - a) * closestParameterToOrigin(a, b);
+  }
+
+  // Support point of the Minkowski difference along with the vertex of
+  // each shape it came from, so closest points can be recovered
+  struct MinkowskiPoint {
+    Vec2 point;
+    Vec2 on1;
+    Vec2 on2;
+  };
+
+  MinkowskiPoint supportPoint(ShapeView shape1, ShapeView shape2, Vec2 direction, Vec2 offset) {
+    Vec2 on1 = shape1[indexOfFurthestPoint(shape1, direction)] + offset;
+    Vec2 on2 = shape2[indexOfFurthestPoint(shape2, -direction)];
+    return {on1 - on2, on1, on2};
+  }
+
+  // Separation between two shapes. The normal points from shape1 towards
+  // shape2, and closest1/closest2 are the closest points on each shape.
+  // None of them are meaningful when the shapes intersect.
+  struct Separation {
+    bool intersects{false};
+    float distance{0.f};
+    Vec2 normal{0.f, 0.f};
+    Vec2 closest1{0.f, 0.f};
+    Vec2 closest2{0.f, 0.f};
+    std::size_t iterations{0};
+  };
+
+  // GJK distance: walks a segment of the Minkowski difference towards the
+  // origin until the support point stops getting closer. shape1 is
+  // translated by offset, which lets sweeps avoid copying vertices.
+  Separation distance(ShapeView shape1, ShapeView shape2, Vec2 offset = Vec2{0.f, 0.f},
+		      std::size_t maxIterations = 32, float tolerance = 1e-4f) {
+    Separation result;
+
+    Vec2 d = averagePoint(shape2) - averagePoint(shape1) - offset;
+    if ((d.x == 0) && (d.y == 0))
+      d.x = 1.f;
+
+    auto a = supportPoint(shape1, shape2, d, offset);
+    auto b = supportPoint(shape1, shape2, -d, offset);
+    float t = closestParameterToOrigin(a.point, b.point);
+
+    while (result.iterations < maxIterations) {
+      ++result.iterations;
+
+      Vec2 p = a.point + (b.point - a.point) * t;
+      float length = glm::length(p);
+      if (length <= tolerance) {
+	result.intersects = true;
+	return result;
+      }
+
+      Vec2 towardsOrigin = -p / length;
+      auto c = supportPoint(shape1, shape2, towardsOrigin, offset);
+
+      // no support point gets closer than the current one, p is the answer
+      if (glm::dot(c.point - p, towardsOrigin) <= tolerance)
+	break;
+
+      // origin inside triangle abc means the shapes overlap
+      Vec2 pa = a.point, pb = b.point, pc = c.point;
+      float abc = (pb.x - pa.x) * (pc.y - pa.y) - (pb.y - pa.y) * (pc.x - pa.x);
+      float ab0 = pa.x * pb.y - pa.y * pb.x;
+      float bc0 = pb.x * pc.y - pb.y * pc.x;
+      float ca0 = pc.x * pa.y - pc.y * pa.x;
+      if (abc != 0.f && ab0 * abc > 0 && bc0 * abc > 0 && ca0 * abc > 0) {
+	result.intersects = true;
+	return result;
+      }
+
+      float t1 = closestParameterToOrigin(pa, pc);
+      float t2 = closestParameterToOrigin(pc, pb);
+      Vec2 p1 = pa + (pc - pa) * t1;
+      Vec2 p2 = pc + (pb - pc) * t2;
+      if (glm::dot(p1, p1) < glm::dot(p2, p2)) {
+	b = c;
+	t = t1;
+      } else {
+	a = c;
+	t = t2;
+      }
+    }
+
+    Vec2 p = a.point + (b.point - a.point) * t;
+    result.distance = glm::length(p);
+    result.normal = -p / result.distance;
+    result.closest1 = a.on1 + (b.on1 - a.on1) * t;
+    result.closest2 = a.on2 + (b.on2 - a.on2) * t;
+    return result;
+  }
+
+  // First contact of a moving shape. time is the fraction of the
+  // displacement travelled before touching, normal follows Contact.
+  struct TimeOfImpact {
+    bool hit{false};
+    float time{1.f};
+    Vec2 normal{0.f, 0.f};
+  };
+
+  // Ray cast of the rect's corner against the target grown by the rect's size
+  TimeOfImpact sweptAABB(Vec4 moving, Vec2 displacement, Vec4 target) {
+    auto overlap = AABB(moving, target);
+    if (overlap.collides)
+      return {true, 0.f, overlap.normal};
+
+    float entry[2], exit[2];
+    float position[2] = {moving.x, moving.y};
+    float size[2] = {moving.z, moving.w};
+    float lo[2] = {target.x, target.y};
+    float hi[2] = {target.x + target.z, target.y + target.w};
+    float delta[2] = {displacement.x, displacement.y};
+
+    for (int axis = 0; axis < 2; ++axis) {
+      if (delta[axis] == 0.f) {
+	if (position[axis] + size[axis] <= lo[axis] || position[axis] >= hi[axis])
+	  return {};
+	entry[axis] = -std::numeric_limits<float>::infinity();
+	exit[axis] = std::numeric_limits<float>::infinity();
+      } else if (delta[axis] > 0) {
+	entry[axis] = (lo[axis] - (position[axis] + size[axis])) / delta[axis];
+	exit[axis] = (hi[axis] - position[axis]) / delta[axis];
       } else {
-	simplex.insert(simplex.begin() + closestIndex, p);
+	entry[axis] = (hi[axis] - position[axis]) / delta[axis];
+	exit[axis] = (lo[axis] - (position[axis] + size[axis])) / delta[axis];
+      }
+    }
+
+    float entryTime = std::max(entry[0], entry[1]);
+    float exitTime = std::min(exit[0], exit[1]);
+    if (entryTime >= exitTime || entryTime < 0.f || entryTime > 1.f)
+      return {};
+
+    // the axis entered last is the one we hit
+    if (entry[0] > entry[1])
+      return {true, entryTime, Vec2{delta[0] > 0 ? 1.f : -1.f, 0.f}};
+    return {true, entryTime, Vec2{0.f, delta[1] > 0 ? 1.f : -1.f}};
+  }
+
+  // Conservative advancement: step shape1 along the displacement by the
+  // current distance over the closing speed, which can never overshoot
+  TimeOfImpact timeOfImpact(ShapeView shape1, Vec2 displacement, ShapeView shape2,
+			    std::size_t maxIterations = 32, float tolerance = 1e-2f) {
+    float t = 0.f;
+    Vec2 lastNormal{0.f, 0.f};
+    for (std::size_t i = 0; i < maxIterations; ++i) {
+      auto separation = distance(shape1, shape2, displacement * t);
+
+      if (separation.intersects) {
+	if (t > 0.f)
+	  return {true, t, lastNormal};
+	return {true, 0.f, collide(shape1, shape2).normal};
+      }
+      lastNormal = separation.normal;
+
+      if (separation.distance <= tolerance)
+	return {true, t, separation.normal};
+
+      float closingSpeed = glm::dot(displacement, separation.normal);
+      if (closingSpeed <= 0.f)
+	return {};
+
+      t += separation.distance / closingSpeed;
+      if (t > 1.f)
+	return {};
+    }
+    return {};
+  }
+
+
+  // Remembers the last GJK direction of each pair of objects. Resting or
+  // slowly moving pairs then usually settle in one or two support points.
+  class GJKCache {
+  public:
+    std::pair<Simplex, bool> GJK(std::size_t id1, std::size_t id2, ShapeView shape1, ShapeView shape2) {
+      auto& direction = directions[pairKey(id1, id2)];
+
+      GJKState state{direction, 0};
+      auto res = collision::GJK(shape1, shape2, state);
+      direction = state.direction;
+
+      ++queryCount;
+      supportCount += state.supports;
+      return res;
+    }
+
+    void forget(std::size_t id1, std::size_t id2) {
+      directions.erase(pairKey(id1, id2));
+    }
+
+    std::size_t queries() const { return queryCount; }
+
+    float averageSupports() const {
+      return queryCount == 0 ? 0.f : static_cast<float>(supportCount) / static_cast<float>(queryCount);
+    }
+
+    void resetStats() {
+      queryCount = 0;
+      supportCount = 0;
+    }
+
+  private:
+    static std::uint64_t pairKey(std::size_t id1, std::size_t id2) {
+      std::uint64_t high = id1;
+      std::uint64_t low = id2 & 0xffffffffu;
+      return (high << 32) | low;
+    }
+
+    std::unordered_map<std::uint64_t, Vec2> directions;
+    std::size_t queryCount{0};
+    std::size_t supportCount{0};
+  };
+
+
+  Contact collide(GJKCache& cache, std::size_t id1, std::size_t id2, ShapeView shape1, ShapeView shape2) {
+    auto res = cache.GJK(id1, id2, shape1, shape2);
+    if (!res.second)
+      return {};
+    auto penetration = EPA(shape1, shape2, res.first);
+    if (penetration.depth <= 0)
+      return {};
+    return {true, penetration.normal, penetration.depth};
+  }
+
+
+  // Separating axis test over the edge normals of both shapes, which must be
+  // convex rings. axis is tried first and updated to the axis that decided
+  // the answer, so a pair that stays apart is rejected after one projection.
+  Contact SAT(ShapeView shape1, ShapeView shape2, Vec2& axis) {
+    auto project = [](ShapeView shape, Vec2 n, float& lo, float& hi) {
+      lo = hi = glm::dot(shape[0], n);
+      for (std::size_t i = 1; i < shape.size(); ++i) {
+	float d = glm::dot(shape[i], n);
+	lo = std::min(lo, d);
+	hi = std::max(hi, d);
       }
+    };
+
+    Contact best{true, Vec2{0.f, 0.f}, std::numeric_limits<float>::max()};
+
+    // returns false when n separates the shapes
+    auto test = [&](Vec2 n) {
+      float lo1, hi1, lo2, hi2;
+      project(shape1, n, lo1, hi1);
+      project(shape2, n, lo2, hi2);
+      float forward = hi1 - lo2;  // move shape1 by -n
+      float backward = hi2 - lo1; // move shape1 by n
+      if (forward <= 0 || backward <= 0)
+	return false;
+      if (forward < best.depth) best = {true, n, forward};
+      if (backward < best.depth) best = {true, -n, backward};
+      return true;
+    };
 
-      return {closestNormal, closestDistance};
+    if ((axis.x != 0 || axis.y != 0) && !test(axis))
+      return {};
+
+    for (ShapeView shape : {shape1, shape2}) {
+      for (std::size_t i = 0; i < shape.size(); ++i) {
+	Vec2 e = shape[(i + 1) % shape.size()] - shape[i];
+	float length = glm::length(e);
+	if (length == 0.f) continue;
+	Vec2 n{e.y / length, -e.x / length};
+	if (!test(n)) {
+	  axis = n;
+	  return {};
+	}
+      }
     }
 
+    axis = best.normal;
+    return best;
+  }
+
+  Contact SAT(ShapeView shape1, ShapeView shape2) {
+    Vec2 axis{0.f, 0.f};
+    return SAT(shape1, shape2, axis);
+  }
+
+  // Minkowski Portal Refinement (XenoCollide). Casts a ray from a point
+  // inside the Minkowski difference towards the origin and refines the
+  // portal edge it crosses until that edge lies on the boundary. The
+  // origin's side of the final portal answers the overlap, and the portal
+  // gives the normal and depth in the same pass: no EPA. The depth is
+  // measured along the ray's exit edge, so it can be larger than the
+  // minimum translation EPA finds, but it always separates the shapes.
+  Contact MPR(ShapeView shape1, ShapeView shape2, std::size_t maxIterations = 32, float tolerance = 1e-3f) {
+    auto cross = [](Vec2 a, Vec2 b) { return a.x * b.y - a.y * b.x; };
+
+    Vec2 v0 = averagePoint(shape1) - averagePoint(shape2);
+    if ((v0.x == 0) && (v0.y == 0))
+      v0.x = 1e-4f; // centers on top of each other: any ray will do
+
+    Vec2 n = -v0;
+    Vec2 v1 = support(shape1, shape2, n);
+    if (glm::dot(v1, n) <= 0)
+      return {};
+
+    // v2 goes on the other side of the origin ray, looking from v0; when
+    // the support lands short of the ray it becomes the new v1
+    Vec2 e, v2;
+    std::size_t i = 0;
+    for (;; ++i) {
+      e = v1 - v0;
+      n = Vec2{e.y, -e.x};
+      if (glm::dot(n, -v0) < 0)
+	n = -n;
+      if ((n.x == 0) && (n.y == 0))
+	return {}; // v1 on top of v0, the difference is a point
+      v2 = support(shape1, shape2, n);
+      if (glm::dot(v2, n) <= 0)
+	return {};
+      if (cross(v1 - v0, -v0) * cross(v2 - v0, -v0) <= 0 || i == maxIterations)
+	break;
+      v1 = v2;
+    }
+
+    bool inside = false;
+    for (; i < maxIterations; ++i) {
+      e = v2 - v1;
+      n = Vec2{e.y, -e.x};
+      if (glm::dot(n, v1 - v0) < 0)
+	n = -n;
+      float length = glm::length(n);
+      if (length == 0.f)
+	break;
+      n /= length;
+
+      // origin on the same side of the portal as v0
+      inside = glm::dot(n, v1) >= 0;
+
+      Vec2 v3 = support(shape1, shape2, n);
+      float boundary = glm::dot(v3, n);
+      if (!inside && boundary <= 0)
+	return {};
+
+      if (boundary - glm::dot(v1, n) <= tolerance) {
+	if (!inside || boundary <= 0)
+	  return {}; // outside, or touching
+	return {true, n, boundary};
+      }
+
+      // keep the half of the portal the origin ray goes through
+      if (cross(v3 - v0, -v0) * cross(v3 - v0, v1 - v0) >= 0)
+	v2 = v3;
+      else
+	v1 = v3;
+    }
+
+    float depth = glm::dot(v1, n);
+    if (!inside || depth <= 0)
+      return {};
+    return {true, n, depth};
+  }
+
+  // Narrowphase used for a pair of rects. AABB is the analytic fast path,
+  // the others run the general polygon algorithms on the rect corners.
+  enum class Engine { AABB, GJK, SAT, MPR };
+
+  Engine parseEngine(std::string const& name, Engine fallback) {
+    if (name == "aabb") return Engine::AABB;
+    if (name == "gjk") return Engine::GJK;
+    if (name == "sat") return Engine::SAT;
+    if (name == "mpr") return Engine::MPR;
+    return fallback;
+  }
+
+  Contact collide(Engine engine, Vec4 rect1, Vec4 rect2) {
+    switch (engine) {
+    case Engine::GJK: {
+      auto points1 = rectToPoints(rect1);
+      auto points2 = rectToPoints(rect2);
+      auto res = GJK(points1, points2);
+      if (!res.second)
+	return {};
+      auto penetration = EPA(points1, points2, res.first);
+      if (penetration.depth <= 0)
+	return {};
+      return {true, penetration.normal, penetration.depth};
+    }
+    case Engine::SAT:
+      return SAT(rectToPoints(rect1), rectToPoints(rect2));
+    case Engine::MPR:
+      return MPR(rectToPoints(rect1), rectToPoints(rect2));
+    case Engine::AABB:
+      break;
+    }
+    return AABB(rect1, rect2);
+  }
+
+  // Whether the rects intersect, skipping the penetration query
+  bool overlaps(Engine engine, Vec4 rect1, Vec4 rect2) {
+    switch (engine) {
+    case Engine::GJK:
+      return GJK(rectToPoints(rect1), rectToPoints(rect2)).second;
+    case Engine::SAT:
+      return SAT(rectToPoints(rect1), rectToPoints(rect2)).collides;
+    case Engine::MPR:
+      return MPR(rectToPoints(rect1), rectToPoints(rect2)).collides;
+    case Engine::AABB:
+      break;
+    }
+    return rect1.x < rect2.x + rect2.z && rect2.x < rect1.x + rect1.z
+      && rect1.y < rect2.y + rect2.w && rect2.y < rect1.y + rect1.w;
   }
 
 }
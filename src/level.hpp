@@ -0,0 +1,229 @@
+#ifndef LEVEL_H
+#define LEVEL_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+using Vec2 = glm::vec2;
+using Vec4 = glm::vec4;
+
+namespace constants {
+  constexpr int tile_width{64};
+  constexpr int tile_height{64};
+}
+
+// Collision categories. An object collides with another when each one's
+// category is in the other's mask.
+namespace layers {
+  constexpr std::uint32_t none{0};
+  constexpr std::uint32_t wall{1u << 0};
+  constexpr std::uint32_t box{1u << 1};
+  constexpr std::uint32_t player{1u << 2};
+  constexpr std::uint32_t goal{1u << 3};
+  constexpr std::uint32_t trigger{1u << 4}; // reported on overlap, never pushes back
+  constexpr std::uint32_t all{~0u};
+}
+
+enum class TextureType : int { Player = 1, Wall, Box, Goal, BoxOnGoal, Ground, Test, Red, Green, Blue };
+
+template<class C>
+struct Physics {
+  Vec2 velocity{0};  
+  Vec2 drag{10};
+  float mass{1};
+
+  void applyForce(Vec2 force, float deltaTime) {
+    Vec2 move = displacement(force, deltaTime);
+
+    derived.rect.x += move.x;
+    derived.rect.y += move.y;
+  }
+
+  // Accelerates and returns how far to move this step. Without a force
+  // the object stays put, velocity is kept for the next push.
+  Vec2 displacement(Vec2 force, float deltaTime) {
+    if (force == Vec2(0, 0)) return Vec2(0, 0);
+
+    accelerate(force, deltaTime);
+    return velocity * deltaTime;
+  }
+
+  // Velocity update only, for continuous collision where the move is swept
+  void accelerate(Vec2 force, float deltaTime) {
+    Vec2 acceleration = force / mass;
+
+    velocity += acceleration * deltaTime;
+
+    auto velLength = glm::length(velocity);
+    if (velLength > 2) {
+      velocity = glm::normalize(velocity) * 2.f;
+    }
+  }
+
+private:
+  Physics(){};
+  C& derived = static_cast<C&>(*this);
+  friend C;
+};
+
+struct GameObject : public Physics<GameObject>
+{
+
+  GameObject(TextureType texT) : tex(texT) {
+    switch (tex) {
+    case TextureType::Player:
+      category = layers::player;
+      mask = layers::wall | layers::box | layers::trigger;
+      break;
+    case TextureType::Wall:
+      category = layers::wall;
+      break;
+    case TextureType::Box:
+    case TextureType::BoxOnGoal:
+      category = layers::box;
+      break;
+    default:
+      // goals and decoration are only drawn
+      mask = layers::none;
+      break;
+    }
+  }
+  
+  TextureType tex;
+  Vec4 rect{0, 0, constants::tile_width, constants::tile_height};
+  std::uint32_t category{layers::none};
+  std::uint32_t mask{layers::all};
+};
+
+// Cheap enough to run on every candidate before the narrowphase
+bool shouldCollide(GameObject const& a, GameObject const& b) {
+  return (a.category & b.mask) != 0 && (b.category & a.mask) != 0;
+}
+
+// Triggers only need to know whether they overlap, not by how much
+bool isTrigger(GameObject const& object) {
+  return (object.category & layers::trigger) != 0;
+}
+
+struct Level {
+
+  enum class LevelObject : int
+    {
+     Player = 1,
+     Wall,
+     Box,
+     Goal,
+     Unknown
+    };
+  
+  Level(unsigned int levelWidth, unsigned int levelHeight, std::string levelDescription)
+    : width(levelWidth), height(levelHeight)
+  {
+    auto pieceAt = [&](std::size_t i, std::size_t j) {
+      auto piece = levelDescription[i + width * j];
+      return static_cast<LevelObject>(std::atoi(&piece));
+    };
+
+    // goals go first in objects, so that boxes pushed onto them are drawn on top
+    for (std::size_t i = 0; i < width; ++i) {
+      for (std::size_t j = 0; j < height; ++j) {
+	if (pieceAt(i, j) != LevelObject::Goal) continue;
+	goals.emplace_back(i, j);
+	objects.emplace_back(TextureType::Goal);
+	objects.back().rect.x = static_cast<float>(i * constants::tile_width);
+	objects.back().rect.y = static_cast<float>(j * constants::tile_height);
+      }
+    }
+
+    for (std::size_t i = 0; i < width; ++i) {
+      for (std::size_t j = 0; j < height; ++j) {
+
+	auto obj = pieceAt(i, j);
+	switch (obj) {
+	case LevelObject::Box:
+	  objects.emplace_back(TextureType::Box);
+	  objects.back().rect.x = i * constants::tile_width;
+	  objects.back().rect.y = j * constants::tile_height;
+	  break;
+	case LevelObject::Wall:
+	  objects.emplace_back(TextureType::Wall);
+	  objects.back().rect.x = i * constants::tile_width;
+	  objects.back().rect.y = j * constants::tile_height;
+	  break;
+	case LevelObject::Player:
+	  playerStartPosition = Vec2(i, j);
+	  break;
+	case LevelObject::Goal:
+	  break;
+	}
+      }
+    }     
+
+    mergeWalls();
+  }
+
+  // Covers the wall tiles with as few rects as a greedy scan finds: each
+  // free wall tile, in reading order, grows right as far as it can and
+  // then down while the whole row below is wall. Walls in colliders are
+  // those rects, the other objects are copied as they are.
+  void mergeWalls() {
+    wallTiles = 0;
+    std::vector<bool> wall(width * height, false);
+    for (auto const& obj : objects) {
+      if (obj.tex != TextureType::Wall) continue;
+      auto x = static_cast<std::size_t>(obj.rect.x) / constants::tile_width;
+      auto y = static_cast<std::size_t>(obj.rect.y) / constants::tile_height;
+      wall[x + width * y] = true;
+      ++wallTiles;
+    }
+
+    colliders.clear();
+    for (std::size_t y = 0; y < height; ++y) {
+      for (std::size_t x = 0; x < width; ++x) {
+	if (!wall[x + width * y]) continue;
+
+	std::size_t right = x + 1;
+	while (right < width && wall[right + width * y]) ++right;
+
+	std::size_t bottom = y + 1;
+	for (; bottom < height; ++bottom) {
+	  bool full = true;
+	  for (std::size_t i = x; i < right && full; ++i) full = wall[i + width * bottom];
+	  if (!full) break;
+	}
+
+	for (std::size_t j = y; j < bottom; ++j) {
+	  for (std::size_t i = x; i < right; ++i) wall[i + width * j] = false;
+	}
+
+	colliders.emplace_back(TextureType::Wall);
+	colliders.back().rect = Vec4{x * constants::tile_width, y * constants::tile_height,
+				     (right - x) * constants::tile_width, (bottom - y) * constants::tile_height};
+      }
+    }
+    mergedWalls = colliders.size();
+
+    for (auto const& obj : objects) {
+      if (obj.tex != TextureType::Wall) colliders.push_back(obj);
+    }
+  }
+    
+  
+  std::size_t width;
+  std::size_t height;
+  Vec2 playerStartPosition;
+  std::vector<Vec2> goals; // in tiles, also in objects for drawing
+
+  std::vector<GameObject> objects; // one per tile, for drawing
+  std::vector<GameObject> colliders; // walls merged into larger rects
+  std::size_t wallTiles{0};
+  std::size_t mergedWalls{0};
+};
+
+#endif /* LEVEL_H */
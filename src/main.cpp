@@ -7,10 +7,16 @@
 #include <chrono>
 #include <thread>
 #include <limits>
+#include <cmath>
 
 #include "sdl2.hpp"
 
+#include "level.hpp"
 #include "collisions.hpp"
+#include "overlap_batch.hpp"
+#include "broadphase.hpp"
+#include "tile_grid.hpp"
+#include "sleeping.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/vec2.hpp>
@@ -21,13 +27,6 @@ using Vec2 = glm::vec2;
 using Vec3 = glm::vec3;
 using Vec4 = glm::vec4;
 
-namespace constants {
-  constexpr int tile_width{64};
-  constexpr int tile_height{64};
-}
-
-enum class TextureType : int { Player = 1, Wall, Box, Goal, BoxOnGoal, Ground, Test, Red, Green, Blue };
-
 std::unordered_map<TextureType, sdl2::sdl_texture_ptr> buildTextures(sdl2::sdl_renderer_ptr& renderer)
 {
   auto playerSurface = sdl2::make_surface(constants::tile_width, constants::tile_height);
@@ -78,45 +77,6 @@ Vec2 lerp(Vec2 start, Vec2 end, float percent) {
   return start + (end - start) * percent;
 }
 
-template<class C>
-struct Physics {
-  Vec2 velocity{0};  
-  Vec2 drag{10};
-  float mass{1};
-
-  void applyForce(Vec2 force, float deltaTime) {
-    if (force == Vec2(0, 0)) return;
-    Vec2 acceleration = force / mass;
-
-    velocity += acceleration * deltaTime;
-
-    auto velLength = glm::length(velocity);
-    if (velLength > 2) {
-      velocity = glm::normalize(velocity) * 2.f;
-    }
-
-
-    derived.rect.x += velocity.x * deltaTime;
-    derived.rect.y += velocity.y * deltaTime;
-  }
-
-private:
-  Physics(){};
-  C& derived = static_cast<C&>(*this);
-  friend C;
-};
-
-struct GameObject : public Physics<GameObject>
-{
-
-  GameObject(TextureType texT) : tex(texT) {
-    
-  }
-  
-  TextureType tex;
-  Vec4 rect{0, 0, constants::tile_width, constants::tile_height};
-};
-
 enum class KeyEvents {
 		      UPKEY = 0,
 		      DOWNKEY,
@@ -127,56 +87,33 @@ enum class KeyEvents {
 };
 
 
-struct Level {
-
-  enum class LevelObject : int
-    {
-     Player = 1,
-     Wall,
-     Box,
-     Goal,
-     Unknown
-    };
-  
-  Level(unsigned int levelWidth, unsigned int levelHeight, std::string levelDescription)
-    : width(levelWidth), height(levelHeight)
-  {
-    for (std::size_t i = 0; i < width; ++i) {
-      for (std::size_t j = 0; j < height; ++j) {
-
-	auto piece = levelDescription[i + width * j];
-	auto obj = static_cast<LevelObject>(std::atoi(&piece));
-	switch (obj) {
-	case LevelObject::Box:
-	  objects.emplace_back(TextureType::Box);
-	  objects.back().rect.x = i * constants::tile_width;
-	  objects.back().rect.y = j * constants::tile_height;
-	  break;
-	case LevelObject::Wall:
-	  objects.emplace_back(TextureType::Wall);
-	  objects.back().rect.x = i * constants::tile_width;
-	  objects.back().rect.y = j * constants::tile_height;
-	  break;
-	case LevelObject::Player:
-	  playerStartPosition = Vec2(i, j);
-	  break;
-	}
-      }
-    }     
-  }
-    
-  
-  std::size_t width;
-  std::size_t height;
-  Vec2 playerStartPosition;
-
-  std::vector<GameObject> objects;
+enum class PhysicsMode {
+			 // resolve overlaps after each small fixed slice
+			 Sliced,
+			 // one step per frame, advancing to the time of impact
+			 Continuous,
+			 // one tile per key press, sokoban rules on the occupancy grid
+			 Tiles
 };
 
-
-
-int main()
+int main(int argc, char* argv[])
 {
+  // usage: sokoban [batch|grid|sap|tree] [aabb|gjk|sat|mpr] [sliced|continuous|tiles] [stats]
+  auto broadphaseType = broadphase::Type::Grid;
+  auto narrowphase = collision::Engine::AABB;
+  auto physicsMode = PhysicsMode::Sliced;
+  bool showStats = false;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "sliced") physicsMode = PhysicsMode::Sliced;
+    else if (arg == "continuous") physicsMode = PhysicsMode::Continuous;
+    else if (arg == "tiles") physicsMode = PhysicsMode::Tiles;
+    else if (arg == "stats") showStats = true;
+    else {
+      broadphaseType = broadphase::parseType(arg, broadphaseType);
+      narrowphase = collision::parseEngine(arg, narrowphase);
+    }
+  }
   
   if (!sdl2::init()) {
     return EXIT_FAILURE;
@@ -224,6 +161,49 @@ int main()
 
   float lastFt{0.f};
   float currentSlice{0.f};
+
+  // collisions run on the merged walls, drawing on the tiles
+  auto const& colliders = level.colliders;
+  std::cout << "Walls: " << level.wallTiles << " tiles merged into " << level.mergedWalls << " rects\n";
+
+  collision::RectSoA objectRects;
+  std::vector<std::uint8_t> objectHits;
+
+  auto grid = broadphase::buildGrid(colliders);
+  std::vector<std::size_t> candidates;
+
+  // the player goes in the sweep and prune as the last body
+  auto sap = broadphase::buildSweepAndPrune(colliders);
+  auto const playerId = colliders.size();
+  sap.insert(playerId, player.rect);
+
+  // same for the tree, where the player is only reinserted once it leaves its fat rect
+  auto tree = broadphase::buildTree(colliders);
+  auto const playerProxy = tree.insert(playerId, player.rect);
+
+  // tile mode: boxes are found by cell when pushed, and the player moves
+  // once per key press rather than while the key is held
+  TileGrid tiles{level};
+  std::unordered_map<std::size_t, std::size_t> boxObjects;
+  for (std::size_t i = 0; i < level.objects.size(); ++i) {
+    auto const& obj = level.objects[i];
+    if (obj.tex == TextureType::Box)
+      boxObjects[tiles.index(static_cast<std::size_t>(obj.rect.x) / constants::tile_width,
+			     static_cast<std::size_t>(obj.rect.y) / constants::tile_height)] = i;
+  }
+  std::vector<bool> previousKeys(keys);
+
+  std::vector<bool> insideTrigger(colliders.size(), false);
+
+  // boxes and the player can sleep, everything else is static
+  physics::SleepSystem sleep;
+  sleep.resize(colliders.size() + 1);
+  for (std::size_t i = 0; i < colliders.size(); ++i) {
+    sleep.setStatic(i, colliders[i].tex != TextureType::Box);
+  }
+
+  float statsTime{0.f};
+  std::size_t statsFrames{0};
   
   while (running) {
 
@@ -302,45 +282,167 @@ int main()
     playerShape.z = player.rect.z;
     playerShape.w = player.rect.w;
 
-    std::vector<Vec2> playerShapeVec{
-				     {playerShape.x,  playerShape.y},
-				     {playerShape.x + playerShape.z,  playerShape.y},
-				     {playerShape.x + playerShape.z,  playerShape.y + playerShape.w},
-				     {playerShape.x,  playerShape.y + playerShape.w}
-				     
+    if (broadphaseType == broadphase::Type::Batch) {
+      objectRects.clear();
+      for (auto& obj : colliders) {
+	objectRects.push(obj.rect);
+      }
+      objectHits.resize(colliders.size());
+    }
+
+    auto findCandidates = [&](Vec4 query) {
+      candidates.clear();
+      switch (broadphaseType) {
+      case broadphase::Type::Batch: {
+	collision::overlapBatch(query, objectRects, objectHits.data());
+	for (std::size_t i = 0; i < colliders.size(); ++i) {
+	  if (objectHits[i]) candidates.push_back(i);
+	}
+      } break;
+      case broadphase::Type::Grid: {
+	grid.query(query, candidates);
+      } break;
+      case broadphase::Type::SweepAndPrune: {
+	sap.update(playerId, query);
+	sap.query(playerId, candidates);
+      } break;
+      case broadphase::Type::Tree: {
+	tree.move(playerProxy, query);
+	tree.query(query, candidates);
+	candidates.erase(std::remove(candidates.begin(), candidates.end(), playerId), candidates.end());
+      } break;
+      }
     };
-    
-    for (;currentSlice >= ftSlice; currentSlice -= ftSlice) {
+
+    if (physicsMode == PhysicsMode::Continuous && currentSlice >= ftSlice) {
+
+      // all the slices of this frame in one step
+      float steps = std::floor(currentSlice / ftSlice);
+      currentSlice -= steps * ftSlice;
+      float deltaTime = steps * static_cast<float>(frame_period{1}.count());
+
+      Vec2 accel{next_player_x, next_player_y};
+      if (accel != Vec2(0, 0)) sleep.wake(playerId);
+      // same as the sliced mode: no input, no move
+      Vec2 move = player.displacement(accel, deltaTime);
+      Vec2 before{player.rect.x, player.rect.y};
+
+      // advance to the first impact, slide along it, and sweep what's left
+      float remaining = 1.f;
+      for (int sweep = 0; sleep.isAwake(playerId) && sweep < 3 && remaining > 0.f; ++sweep) {
+	Vec2 displacement = move * remaining;
+	if (displacement == Vec2(0, 0)) break;
+
+	Vec4 sweptShape{std::min(playerShape.x, playerShape.x + displacement.x),
+			std::min(playerShape.y, playerShape.y + displacement.y),
+			playerShape.z + std::abs(displacement.x),
+			playerShape.w + std::abs(displacement.y)};
+	findCandidates(sweptShape);
+
+	collision::TimeOfImpact first;
+	for (auto i : candidates) {
+	  auto const& obj = colliders[i];
+	  if (!shouldCollide(player, obj) || isTrigger(obj)) continue;
+	  auto toi = collision::sweptAABB(playerShape, displacement, colliders[i].rect);
+	  if (toi.hit) sleep.addContact(playerId, i);
+	  if (toi.hit && toi.time < first.time) first = toi;
+	}
+
+	player.rect.x += displacement.x * first.time;
+	player.rect.y += displacement.y * first.time;
+	playerShape.x += displacement.x * first.time;
+	playerShape.y += displacement.y * first.time;
+
+	if (!first.hit) break;
+
+	player.velocity -= first.normal * glm::dot(player.velocity, first.normal);
+	move -= first.normal * glm::dot(move, first.normal);
+	remaining *= 1.f - first.time;
+      }
+      Vec2 moved = Vec2{player.rect.x, player.rect.y} - before;
+      sleep.update(playerId, glm::length(moved) / deltaTime);
+      sleep.solveIslands(deltaTime);
+    }
+
+    if (physicsMode == PhysicsMode::Tiles) {
+      auto pressed = [&](KeyEvents key) {
+	auto index = static_cast<std::size_t>(key);
+	return keys[index] && !previousKeys[index];
+      };
+      int dx = 0;
+      int dy = 0;
+      if (pressed(KeyEvents::UPKEY)) dy = -1;
+      else if (pressed(KeyEvents::DOWNKEY)) dy = 1;
+      else if (pressed(KeyEvents::LEFTKEY)) dx = -1;
+      else if (pressed(KeyEvents::RIGHTKEY)) dx = 1;
+      previousKeys = keys;
+
+      if (dx != 0 || dy != 0) {
+	auto result = tiles.move(dx, dy);
+	if (result.move == TileGrid::Move::Pushed) {
+	  auto box = boxObjects.find(result.boxFrom);
+	  if (box != boxObjects.end()) {
+	    auto index = box->second;
+	    boxObjects.erase(box);
+	    boxObjects[result.boxTo] = index;
+	    level.objects[index].rect.x = static_cast<float>(tiles.column(result.boxTo) * constants::tile_width);
+	    level.objects[index].rect.y = static_cast<float>(tiles.row(result.boxTo) * constants::tile_height);
+	    bool onGoal = (tiles.at(tiles.column(result.boxTo), tiles.row(result.boxTo)) & TileGrid::Goal) != 0;
+	    level.objects[index].tex = onGoal ? TextureType::BoxOnGoal : TextureType::Box;
+	  }
+	  if (tiles.solved()) std::cout << "Solved!\n";
+	}
+      }
+
+      // the player is drawn centered on x and standing on y
+      player.rect.x = static_cast<float>(tiles.column(tiles.playerCell()) * constants::tile_width) + player.rect.z / 2;
+      player.rect.y = static_cast<float>(tiles.row(tiles.playerCell()) * constants::tile_height) + player.rect.w;
+      currentSlice = 0.f;
+    }
+
+    for (;physicsMode == PhysicsMode::Sliced && currentSlice >= ftSlice; currentSlice -= ftSlice) {
       
       Vec2 accel{next_player_x, next_player_y};    
-      player.applyForce(accel, frame_period{1}.count());
+      if (accel != Vec2(0, 0)) sleep.wake(playerId);
+
+      // nothing moved since the last contacts were resolved
+      if (!sleep.isAwake(playerId)) continue;
+
+      Vec2 before{player.rect.x, player.rect.y};
+      float deltaTime = static_cast<float>(frame_period{1}.count());
+      player.applyForce(accel, deltaTime);
       
-      for (auto& obj : level.objects) {
+      findCandidates(playerShape);
+
+      for (auto i : candidates) {
+
+	auto& obj = colliders[i];
+	if (!shouldCollide(player, obj)) continue;
 
-	auto res = collision::GJK(playerShape, obj.rect);
+	if (isTrigger(obj)) {
+	  bool inside = collision::overlaps(narrowphase, playerShape, obj.rect);
+	  if (inside && !insideTrigger[i]) std::cout << "Entered trigger " << i << "\n";
+	  insideTrigger[i] = inside;
+	  continue;
+	}
+
+	auto contact = collision::collide(narrowphase, playerShape, obj.rect);
 	
-	if (res.second) {
-
-	  std::vector<Vec2> objectVec{
-				     {obj.rect.x, obj.rect.y},
-				     {obj.rect.x + obj.rect.z, obj.rect.y},
-				     {obj.rect.x + obj.rect.z, obj.rect.y + obj.rect.w},
-				     {obj.rect.x, obj.rect.y + obj.rect.w}
-				     
-	  };
-    
-	  
-	  auto res2 = collision::EPA(playerShapeVec, objectVec, res.first);
+	if (contact.collides) {
+	  sleep.addContact(playerId, i);
 
-	  player.rect.x -= (res2.first.x) * (res2.second);
-	  player.rect.y -= (res2.first.y) * (res2.second);
+	  player.rect.x -= (contact.normal.x) * (contact.depth);
+	  player.rect.y -= (contact.normal.y) * (contact.depth);
 
 	  // make player slide against wall
-	  player.velocity -= glm::normalize(res2.first) * glm::dot(player.velocity, glm::normalize(res2.first));
+	  player.velocity -= glm::normalize(contact.normal) * glm::dot(player.velocity, glm::normalize(contact.normal));
 	  
 	}
       }
-      
+
+      Vec2 moved = Vec2{player.rect.x, player.rect.y} - before;
+      sleep.update(playerId, glm::length(moved) / deltaTime);
+      sleep.solveIslands(deltaTime);
     }
       
       /* DRAWING */
@@ -372,6 +474,18 @@ int main()
       float ft{std::chrono::duration_cast<std::chrono::duration<float, std::milli>>(elapsedTime).count()};
 
       lastFt = ft;
+
+      if (showStats) {
+	statsTime += ft;
+	++statsFrames;
+	if (statsTime >= 1000.f) {
+	  std::cout << "FT: " << statsTime / static_cast<float>(statsFrames)
+		    << " FPS: " << static_cast<float>(statsFrames) * 1000.f / statsTime
+		    << " awake: " << sleep.awakeCount() << "\n";
+	  statsTime = 0.f;
+	  statsFrames = 0;
+	}
+      }
       /*
       auto ftSeconds(ft / 1000.f);
       auto fps(1.f / ftSeconds);
@@ -0,0 +1,168 @@
+#ifndef MANIFOLD_H
+#define MANIFOLD_H
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+
+#include "collisions.hpp"
+
+namespace collision {
+
+  struct ContactPoint {
+    Vec2 position{0.f, 0.f};
+    float depth{0.f};
+    float impulse{0.f}; // left to the solver, carried over while the point persists
+    std::size_t age{0}; // frames this point has survived
+  };
+
+  // Up to two contact points sharing the normal of the Contact they came from
+  struct Manifold {
+    Vec2 normal{0.f, 0.f};
+    std::array<ContactPoint, 2> points{};
+    std::size_t count{0};
+  };
+
+  namespace detail {
+
+    struct Edge {
+      Vec2 max; // vertex furthest along the search direction
+      Vec2 a;
+      Vec2 b;
+    };
+
+    // The edge next to the furthest vertex that is most perpendicular to n
+    Edge bestEdge(ShapeView shape, Vec2 n) {
+      std::size_t count = shape.size();
+      std::size_t index = indexOfFurthestPoint(shape, n);
+      Vec2 v = shape[index];
+      Vec2 next = shape[(index + 1) % count];
+      Vec2 prev = shape[(index + count - 1) % count];
+
+      Vec2 left = glm::normalize(v - next);
+      Vec2 right = glm::normalize(v - prev);
+      if (std::abs(glm::dot(right, n)) <= std::abs(glm::dot(left, n)))
+	return {v, prev, v};
+      return {v, v, next};
+    }
+
+    // Keeps the part of segment [a, b] where dot(n, p) >= o. May drop a point.
+    std::size_t clip(Vec2 a, Vec2 b, Vec2 n, float o, std::array<Vec2, 2>& out) {
+      std::size_t count = 0;
+      float da = glm::dot(n, a) - o;
+      float db = glm::dot(n, b) - o;
+      if (da >= 0) out[count++] = a;
+      if (db >= 0) out[count++] = b;
+      if (da * db < 0 && count < 2) {
+	out[count++] = a + (b - a) * (da / (da - db));
+      }
+      return count;
+    }
+
+  }
+
+  // Clips the incident edge against the reference edge (the one facing the
+  // normal most squarely). The normal follows Contact: shape1 moves by -normal.
+  Manifold manifold(ShapeView shape1, ShapeView shape2, Contact const& contact) {
+    Manifold result;
+    result.normal = contact.normal;
+    if (!contact.collides || shape1.size() < 2 || shape2.size() < 2)
+      return result;
+
+    Vec2 n = contact.normal;
+    auto edge1 = detail::bestEdge(shape1, n);
+    auto edge2 = detail::bestEdge(shape2, -n);
+
+    auto reference = edge1;
+    auto incident = edge2;
+    bool flip = false;
+    if (std::abs(glm::dot(edge1.b - edge1.a, n)) > std::abs(glm::dot(edge2.b - edge2.a, n))) {
+      reference = edge2;
+      incident = edge1;
+      flip = true;
+    }
+
+    Vec2 refDirection = glm::normalize(reference.b - reference.a);
+
+    // side planes of the reference edge
+    std::array<Vec2, 2> clipped;
+    float o1 = glm::dot(refDirection, reference.a);
+    if (detail::clip(incident.a, incident.b, refDirection, o1, clipped) < 2)
+      return result;
+    float o2 = glm::dot(refDirection, reference.b);
+    if (detail::clip(clipped[0], clipped[1], -refDirection, -o2, clipped) < 2)
+      return result;
+
+    // reference face: keep points that went past it
+    Vec2 refNormal = flip ? -n : n;
+    float max = glm::dot(refNormal, reference.max);
+    for (Vec2 point : clipped) {
+      float depth = max - glm::dot(refNormal, point);
+      if (depth >= 0) {
+	result.points[result.count].position = point;
+	result.points[result.count].depth = depth;
+	++result.count;
+      }
+    }
+    return result;
+  }
+
+  // Keeps manifolds across frames, keyed by pair of object ids. Points that
+  // come back within persistDistance of last frame's keep their impulse and
+  // age, and pairs that aren't updated during a frame are dropped.
+  class ManifoldCache {
+  public:
+    explicit ManifoldCache(float distance = 2.f) : persistDistance(distance) {}
+
+    void beginFrame() { ++frame; }
+
+    Manifold const& update(std::size_t id1, std::size_t id2, Manifold fresh) {
+      auto& entry = manifolds[pairKey(id1, id2)];
+      if (entry.frame + 1 == frame) {
+	for (std::size_t i = 0; i < fresh.count; ++i) {
+	  for (std::size_t j = 0; j < entry.manifold.count; ++j) {
+	    auto const& old = entry.manifold.points[j];
+	    if (glm::length(old.position - fresh.points[i].position) <= persistDistance) {
+	      fresh.points[i].impulse = old.impulse;
+	      fresh.points[i].age = old.age + 1;
+	      break;
+	    }
+	  }
+	}
+      }
+      entry.manifold = fresh;
+      entry.frame = frame;
+      return entry.manifold;
+    }
+
+    // Drops the pairs that weren't in contact this frame
+    void endFrame() {
+      for (auto it = manifolds.begin(); it != manifolds.end();) {
+	if (it->second.frame != frame) it = manifolds.erase(it);
+	else ++it;
+      }
+    }
+
+    std::size_t size() const { return manifolds.size(); }
+
+  private:
+    struct Entry {
+      Manifold manifold;
+      std::uint64_t frame{0};
+    };
+
+    static std::uint64_t pairKey(std::size_t id1, std::size_t id2) {
+      std::uint64_t high = id1;
+      std::uint64_t low = id2 & 0xffffffffu;
+      return (high << 32) | low;
+    }
+
+    std::unordered_map<std::uint64_t, Entry> manifolds;
+    std::uint64_t frame{1};
+    float persistDistance;
+  };
+
+}
+
+#endif /* MANIFOLD_H */
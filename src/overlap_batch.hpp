@@ -0,0 +1,141 @@
+#ifndef OVERLAP_BATCH_H
+#define OVERLAP_BATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define SOKOBAN_HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(SOKOBAN_HAS_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define SOKOBAN_HAS_AVX2 1
+#include <immintrin.h>
+#endif
+
+#include "collisions.hpp"
+
+namespace collision {
+
+  // Structure-of-arrays copy of a set of rects, laid out for overlapBatch
+  struct RectSoA {
+    void clear() {
+      xs.clear();
+      ys.clear();
+      ws.clear();
+      hs.clear();
+    }
+
+    void push(Vec4 rect) {
+      xs.push_back(rect.x);
+      ys.push_back(rect.y);
+      ws.push_back(rect.z);
+      hs.push_back(rect.w);
+    }
+
+    std::size_t size() const { return xs.size(); }
+
+    std::vector<float> xs;
+    std::vector<float> ys;
+    std::vector<float> ws;
+    std::vector<float> hs;
+  };
+
+  namespace detail {
+
+    using OverlapBatchFn = void (*)(Vec4, float const*, float const*, float const*, float const*, std::size_t, std::uint8_t*);
+
+    // out[i] is 1 when rect i overlaps the query. Touching doesn't count, same as AABB.
+    void overlapBatchScalar(Vec4 query, float const* xs, float const* ys, float const* ws, float const* hs,
+			    std::size_t n, std::uint8_t* out) {
+      float right = query.x + query.z;
+      float bottom = query.y + query.w;
+      for (std::size_t i = 0; i < n; ++i) {
+	bool overlap = query.x < xs[i] + ws[i] && xs[i] < right
+	  && query.y < ys[i] + hs[i] && ys[i] < bottom;
+	out[i] = overlap ? 1 : 0;
+      }
+    }
+
+#ifdef SOKOBAN_HAS_SSE2
+    void overlapBatchSSE2(Vec4 query, float const* xs, float const* ys, float const* ws, float const* hs,
+			  std::size_t n, std::uint8_t* out) {
+      __m128 left = _mm_set1_ps(query.x);
+      __m128 top = _mm_set1_ps(query.y);
+      __m128 right = _mm_set1_ps(query.x + query.z);
+      __m128 bottom = _mm_set1_ps(query.y + query.w);
+
+      std::size_t i = 0;
+      for (; i + 4 <= n; i += 4) {
+	__m128 x = _mm_loadu_ps(xs + i);
+	__m128 y = _mm_loadu_ps(ys + i);
+	__m128 mask = _mm_and_ps(_mm_and_ps(_mm_cmplt_ps(left, _mm_add_ps(x, _mm_loadu_ps(ws + i))),
+					    _mm_cmplt_ps(x, right)),
+				 _mm_and_ps(_mm_cmplt_ps(top, _mm_add_ps(y, _mm_loadu_ps(hs + i))),
+					    _mm_cmplt_ps(y, bottom)));
+	int bits = _mm_movemask_ps(mask);
+	for (std::size_t k = 0; k < 4; ++k) {
+	  out[i + k] = static_cast<std::uint8_t>((bits >> k) & 1);
+	}
+      }
+      overlapBatchScalar(query, xs + i, ys + i, ws + i, hs + i, n - i, out + i);
+    }
+#endif
+
+#ifdef SOKOBAN_HAS_AVX2
+    __attribute__((target("avx2")))
+    void overlapBatchAVX2(Vec4 query, float const* xs, float const* ys, float const* ws, float const* hs,
+			  std::size_t n, std::uint8_t* out) {
+      __m256 left = _mm256_set1_ps(query.x);
+      __m256 top = _mm256_set1_ps(query.y);
+      __m256 right = _mm256_set1_ps(query.x + query.z);
+      __m256 bottom = _mm256_set1_ps(query.y + query.w);
+
+      std::size_t i = 0;
+      for (; i + 8 <= n; i += 8) {
+	__m256 x = _mm256_loadu_ps(xs + i);
+	__m256 y = _mm256_loadu_ps(ys + i);
+	__m256 mask = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(left, _mm256_add_ps(x, _mm256_loadu_ps(ws + i)), _CMP_LT_OQ),
+						  _mm256_cmp_ps(x, right, _CMP_LT_OQ)),
+				    _mm256_and_ps(_mm256_cmp_ps(top, _mm256_add_ps(y, _mm256_loadu_ps(hs + i)), _CMP_LT_OQ),
+						  _mm256_cmp_ps(y, bottom, _CMP_LT_OQ)));
+	int bits = _mm256_movemask_ps(mask);
+	for (std::size_t k = 0; k < 8; ++k) {
+	  out[i + k] = static_cast<std::uint8_t>((bits >> k) & 1);
+	}
+      }
+      overlapBatchScalar(query, xs + i, ys + i, ws + i, hs + i, n - i, out + i);
+    }
+#endif
+
+    OverlapBatchFn selectOverlapBatch() {
+#ifdef SOKOBAN_HAS_AVX2
+      if (__builtin_cpu_supports("avx2"))
+	return overlapBatchAVX2;
+#endif
+#ifdef SOKOBAN_HAS_SSE2
+      return overlapBatchSSE2;
+#else
+      return overlapBatchScalar;
+#endif
+    }
+
+  }
+
+  // Tests one query rect against n rects stored as separate x/y/width/height
+  // arrays, picking the widest SIMD kernel the CPU supports on first use
+  void overlapBatch(Vec4 query, float const* xs, float const* ys, float const* ws, float const* hs,
+		    std::size_t n, std::uint8_t* out) {
+    static detail::OverlapBatchFn const kernel = detail::selectOverlapBatch();
+    kernel(query, xs, ys, ws, hs, n, out);
+  }
+
+  void overlapBatch(Vec4 query, RectSoA const& rects, std::uint8_t* out) {
+    overlapBatch(query, rects.xs.data(), rects.ys.data(), rects.ws.data(), rects.hs.data(), rects.size(), out);
+  }
+
+}
+
+#endif /* OVERLAP_BATCH_H */
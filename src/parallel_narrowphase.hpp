@@ -0,0 +1,79 @@
+#ifndef PARALLEL_NARROWPHASE_H
+#define PARALLEL_NARROWPHASE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "collisions.hpp"
+#include "thread_pool.hpp"
+
+namespace collision {
+
+  struct PairContact {
+    std::size_t first;
+    std::size_t second;
+    Contact contact;
+  };
+
+  // Runs the narrowphase over a broadphase's candidate pairs on a thread
+  // pool. Pairs are cut into contiguous chunks with one result buffer each,
+  // and the buffers are appended in chunk order, so the output lists the
+  // colliding pairs in input order whatever the scheduling was.
+  class ParallelNarrowphase {
+  public:
+    using Pairs = std::vector<std::pair<std::size_t, std::size_t>>;
+
+    explicit ParallelNarrowphase(ThreadPool& threadPool, std::size_t minChunk = 64)
+      : pool(threadPool), minChunkSize(std::max<std::size_t>(minChunk, 1)) {}
+
+    // Rects indexed by the ids in pairs, tested with the given engine
+    void collide(Engine engine, std::vector<Vec4> const& rects, Pairs const& pairs,
+		 std::vector<PairContact>& out) {
+      run(pairs, out, [&](std::size_t a, std::size_t b) {
+	  return collision::collide(engine, rects[a], rects[b]);
+	});
+    }
+
+    // GJK + EPA over arbitrary convex shapes. Climbing hints are dropped:
+    // a shape can be in several pairs at once and the hint is written by
+    // every support query.
+    void collide(std::vector<ShapeView> const& shapes, Pairs const& pairs, std::vector<PairContact>& out) {
+      run(pairs, out, [&](std::size_t a, std::size_t b) {
+	  return collision::collide(ShapeView{shapes[a].points, shapes[a].count},
+				    ShapeView{shapes[b].points, shapes[b].count});
+	});
+    }
+
+  private:
+    template<class Narrowphase>
+    void run(Pairs const& pairs, std::vector<PairContact>& out, Narrowphase narrowphase) {
+      // a few chunks per thread so uneven pairs still balance out
+      std::size_t chunkSize = std::max(minChunkSize, pairs.size() / (pool.size() * 4) + 1);
+      std::size_t chunks = (pairs.size() + chunkSize - 1) / chunkSize;
+      if (buffers.size() < chunks) buffers.resize(chunks);
+
+      pool.run(chunks, [&](std::size_t chunk) {
+	  auto& buffer = buffers[chunk];
+	  buffer.clear();
+	  std::size_t end = std::min(pairs.size(), (chunk + 1) * chunkSize);
+	  for (std::size_t i = chunk * chunkSize; i < end; ++i) {
+	    auto contact = narrowphase(pairs[i].first, pairs[i].second);
+	    if (contact.collides) buffer.push_back({pairs[i].first, pairs[i].second, contact});
+	  }
+	});
+
+      for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+	out.insert(out.end(), buffers[chunk].begin(), buffers[chunk].end());
+      }
+    }
+
+    ThreadPool& pool;
+    std::size_t minChunkSize;
+    std::vector<std::vector<PairContact>> buffers; // kept between calls to reuse their storage
+  };
+
+}
+
+#endif /* PARALLEL_NARROWPHASE_H */
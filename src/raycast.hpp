@@ -0,0 +1,110 @@
+#ifndef RAYCAST_H
+#define RAYCAST_H
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include "collisions.hpp"
+#include "tile_grid.hpp"
+
+namespace collision {
+
+  // First thing a segment from -> to runs into. fraction is how far along
+  // the segment, normal is the surface normal facing the ray.
+  struct RayHit {
+    bool hit{false};
+    float fraction{1.f};
+    Vec2 point{0.f, 0.f};
+    Vec2 normal{0.f, 0.f};
+    std::size_t cell{0}; // only set by tile casts
+  };
+
+  // Amanatides-Woo traversal: visits the tiles under the segment in order,
+  // one step per tile border crossed, and stops at the first blocking one.
+  // Positions are in pixels; tiles outside the grid never block.
+  RayHit castRay(TileGrid const& tiles, Vec2 from, Vec2 to,
+		 std::uint8_t blocking = TileGrid::Wall | TileGrid::Box) {
+    float const tileWidth = constants::tile_width;
+    float const tileHeight = constants::tile_height;
+    float const infinity = std::numeric_limits<float>::infinity();
+
+    Vec2 direction = to - from;
+    auto x = static_cast<long long>(std::floor(from.x / tileWidth));
+    auto y = static_cast<long long>(std::floor(from.y / tileHeight));
+
+    auto blocks = [&](long long cellX, long long cellY) {
+      if (cellX < 0 || cellY < 0 || cellX >= static_cast<long long>(tiles.width)
+	  || cellY >= static_cast<long long>(tiles.height))
+	return false;
+      return (tiles.at(static_cast<std::size_t>(cellX), static_cast<std::size_t>(cellY)) & blocking) != 0;
+    };
+    auto hitAt = [&](float t, Vec2 normal) {
+      RayHit hit;
+      hit.hit = true;
+      hit.fraction = t;
+      hit.point = from + direction * t;
+      hit.normal = normal;
+      hit.cell = tiles.index(static_cast<std::size_t>(x), static_cast<std::size_t>(y));
+      return hit;
+    };
+
+    if (blocks(x, y))
+      return hitAt(0.f, Vec2{0.f, 0.f});
+
+    int stepX = direction.x > 0 ? 1 : -1;
+    int stepY = direction.y > 0 ? 1 : -1;
+    // segment fraction at the next vertical / horizontal border, and between two of them
+    float deltaX = direction.x != 0 ? tileWidth / std::abs(direction.x) : infinity;
+    float deltaY = direction.y != 0 ? tileHeight / std::abs(direction.y) : infinity;
+    float nextX = infinity;
+    float nextY = infinity;
+    if (direction.x != 0)
+      nextX = ((static_cast<float>(x + (stepX > 0 ? 1 : 0))) * tileWidth - from.x) / direction.x;
+    if (direction.y != 0)
+      nextY = ((static_cast<float>(y + (stepY > 0 ? 1 : 0))) * tileHeight - from.y) / direction.y;
+
+    for (;;) {
+      float t;
+      Vec2 normal;
+      if (nextX < nextY) {
+	t = nextX;
+	x += stepX;
+	nextX += deltaX;
+	normal = Vec2{static_cast<float>(-stepX), 0.f};
+      } else {
+	t = nextY;
+	y += stepY;
+	nextY += deltaY;
+	normal = Vec2{0.f, static_cast<float>(-stepY)};
+      }
+      if (t > 1.f)
+	return {};
+      if (blocks(x, y))
+	return hitAt(t, normal);
+    }
+  }
+
+  bool lineOfSight(TileGrid const& tiles, Vec2 from, Vec2 to,
+		   std::uint8_t blocking = TileGrid::Wall | TileGrid::Box) {
+    return !castRay(tiles, from, to, blocking).hit;
+  }
+
+  // Fallback for shapes that aren't tiles: the ray is a point swept along
+  // the segment, so this is conservative advancement on GJK distance
+  RayHit castRay(ShapeView shape, Vec2 from, Vec2 to, float tolerance = 1e-2f) {
+    Vec2 direction = to - from;
+    auto toi = timeOfImpact(ShapeView{&from, 1}, direction, shape, 32, tolerance);
+    RayHit hit;
+    if (!toi.hit)
+      return hit;
+    hit.hit = true;
+    hit.fraction = toi.time;
+    hit.point = from + direction * toi.time;
+    hit.normal = -toi.normal;
+    return hit;
+  }
+
+}
+
+#endif /* RAYCAST_H */
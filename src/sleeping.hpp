@@ -0,0 +1,125 @@
+#ifndef SLEEPING_H
+#define SLEEPING_H
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace physics {
+
+  // Puts bodies to sleep once they've been slower than sleepSpeed for
+  // timeToSleep, so the caller can skip stepping and testing them. Bodies
+  // touching each other form an island: it only sleeps when all of its
+  // bodies are at rest, and anything moving in it keeps the others awake.
+  // Static bodies (walls) never join an island, so they don't chain every
+  // body resting on them together.
+  class SleepSystem {
+  public:
+    explicit SleepSystem(float speed = 0.05f, float time = 30.f)
+      : sleepSpeed(speed), timeToSleep(time) {}
+
+    void resize(std::size_t count) {
+      bodies.resize(count);
+      parents.resize(count);
+    }
+
+    void setStatic(std::size_t id, bool isStatic) {
+      bodies[id].isStatic = isStatic;
+      bodies[id].awake = !isStatic;
+    }
+
+    // Records how fast the body moved. Bodies that aren't updated during a
+    // step are taken as resting.
+    void update(std::size_t id, float speed) {
+      if (speed > sleepSpeed) wake(id);
+    }
+
+    // Input or a script touched the body: it has to be simulated again
+    void wake(std::size_t id) {
+      auto& body = bodies[id];
+      if (body.isStatic) return;
+      body.moved = true;
+      body.awake = true;
+    }
+
+    void addContact(std::size_t id1, std::size_t id2) {
+      contacts.emplace_back(id1, id2);
+    }
+
+    // Ends a step of length dt: groups the bodies by the contacts recorded
+    // since the last call, then wakes or puts to sleep each island as a whole
+    void solveIslands(float dt) {
+      for (auto& body : bodies) {
+	body.restTime = body.moved ? 0.f : body.restTime + dt;
+	body.moved = false;
+      }
+
+      for (std::size_t i = 0; i < parents.size(); ++i) parents[i] = i;
+      for (auto const& contact : contacts) {
+	if (bodies[contact.first].isStatic || bodies[contact.second].isStatic) continue;
+	// a sleeping body hit by an awake one wakes up with it
+	parents[find(contact.first)] = find(contact.second);
+      }
+      contacts.clear();
+
+      // an island is restless while any of its bodies is: keep the
+      // smallest rest time of each island at its root
+      islandRest.assign(bodies.size(), -1.f);
+      for (std::size_t i = 0; i < bodies.size(); ++i) {
+	if (bodies[i].isStatic) continue;
+	auto& rest = islandRest[find(i)];
+	rest = rest < 0.f ? bodies[i].restTime : std::min(rest, bodies[i].restTime);
+      }
+
+      islands = 0;
+      awake = 0;
+      for (std::size_t i = 0; i < bodies.size(); ++i) {
+	auto& body = bodies[i];
+	if (body.isStatic) continue;
+	auto root = find(i);
+	if (root == i) ++islands;
+
+	float rest = islandRest[root];
+	body.awake = rest < timeToSleep;
+	if (body.awake) {
+	  body.restTime = std::min(body.restTime, rest);
+	  ++awake;
+	}
+      }
+    }
+
+    bool isAwake(std::size_t id) const { return bodies[id].awake; }
+
+    std::size_t awakeCount() const { return awake; }
+    std::size_t islandCount() const { return islands; }
+
+  private:
+    struct Body {
+      float restTime{0.f};
+      bool moved{false};
+      bool awake{true};
+      bool isStatic{false};
+    };
+
+    std::size_t find(std::size_t id) {
+      while (parents[id] != id) {
+	parents[id] = parents[parents[id]];
+	id = parents[id];
+      }
+      return id;
+    }
+
+    float sleepSpeed;
+    float timeToSleep;
+    std::vector<Body> bodies;
+    std::vector<std::size_t> parents; // union-find forest, rebuilt every solveIslands
+    std::vector<float> islandRest;
+    std::vector<std::pair<std::size_t, std::size_t>> contacts;
+    std::size_t islands{0};
+    std::size_t awake{0};
+  };
+
+}
+
+#endif /* SLEEPING_H */
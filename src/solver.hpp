@@ -0,0 +1,539 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "level.hpp"
+#include "tile_grid.hpp"
+
+// Headless sokoban solver. Searches over pushes rather than steps: a
+// state is the set of box cells plus the area the player can walk to,
+// stood for by its top-left-most cell, so walking around never creates
+// new states. A* orders the pushes, with the sum of each box's push
+// distance to its nearest goal as heuristic. States are stored packed,
+// one bit per interior cell, see StateCodec.
+namespace solver {
+
+  struct Stats {
+    std::size_t expanded{0};
+    std::size_t generated{0};
+    double milliseconds{0.0};
+    std::size_t peakBytes{0}; // estimated from the search containers
+    std::size_t bytesPerState{0}; // packed size of one state
+  };
+
+  struct Solution {
+    bool solved{false};
+    bool exhausted{false}; // every reachable state was tried: no solution exists
+    std::string moves;     // LURD: lowercase walks, uppercase pushes
+    std::size_t pushes{0};
+    Stats stats;
+  };
+
+  // Box cells as one bit each over the interior cells, then one word with
+  // the normalized player cell
+  struct PackedState {
+    std::vector<std::uint64_t> words;
+
+    bool operator==(PackedState const& other) const { return words == other.words; }
+    bool operator!=(PackedState const& other) const { return words != other.words; }
+  };
+
+  std::size_t hashWords(std::uint64_t const* words, std::size_t count) {
+    std::uint64_t h = 0x9e3779b97f4a7c15ull;
+    for (std::size_t i = 0; i < count; ++i) {
+      // splitmix64 finalizer on each word
+      std::uint64_t x = words[i] + 0x9e3779b97f4a7c15ull * (i + 1);
+      x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+      x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+      h ^= x ^ (x >> 31);
+      h *= 0x100000001b3ull;
+    }
+    return h;
+  }
+
+  struct PackedStateHash {
+    std::size_t operator()(PackedState const& state) const {
+      return hashWords(state.words.data(), state.words.size());
+    }
+  };
+
+  // Maps the interior cells, the ones the player could walk to if there
+  // were no boxes, to bits. Boxes can only ever be pushed onto those.
+  class StateCodec {
+  public:
+    explicit StateCodec(TileGrid const& tiles)
+      : bitOf(tiles.width * tiles.height, none())
+    {
+      std::vector<std::size_t> frontier{tiles.playerCell()};
+      bitOf[frontier[0]] = 0;
+      for (std::size_t i = 0; i < frontier.size(); ++i) {
+	std::size_t x = tiles.column(frontier[i]);
+	std::size_t y = tiles.row(frontier[i]);
+	std::size_t next[4] = {frontier[i] - tiles.width, frontier[i] + tiles.width, frontier[i] - 1, frontier[i] + 1};
+	bool inside[4] = {y > 0, y + 1 < tiles.height, x > 0, x + 1 < tiles.width};
+	for (int d = 0; d < 4; ++d) {
+	  if (inside[d] && bitOf[next[d]] == none() && !(tiles.at(tiles.column(next[d]), tiles.row(next[d])) & TileGrid::Wall)) {
+	    bitOf[next[d]] = 0;
+	    frontier.push_back(next[d]);
+	  }
+	}
+      }
+      // boxes walled in where the player can't go still need a bit
+      for (std::size_t cell = 0; cell < bitOf.size(); ++cell) {
+	if (tiles.at(tiles.column(cell), tiles.row(cell)) & TileGrid::Box) bitOf[cell] = 0;
+      }
+      for (std::size_t cell = 0; cell < bitOf.size(); ++cell) {
+	if (bitOf[cell] == none()) continue;
+	bitOf[cell] = static_cast<std::uint32_t>(cellOf.size());
+	cellOf.push_back(cell);
+      }
+    }
+
+    std::size_t cells() const { return cellOf.size(); }
+    bool interior(std::size_t cell) const { return bitOf[cell] != none(); }
+
+    std::size_t words() const { return (cellOf.size() + 63) / 64 + 1; }
+    std::size_t bytesPerState() const { return words() * sizeof(std::uint64_t); }
+
+    // Writes words() words to out. Boxes don't have to be sorted.
+    void pack(std::vector<std::size_t> const& boxes, std::size_t player, std::uint64_t* out) const {
+      std::fill(out, out + words(), 0);
+      for (auto box : boxes) {
+	std::uint32_t bit = bitOf[box];
+	out[bit / 64] |= std::uint64_t{1} << (bit % 64);
+      }
+      out[words() - 1] = player;
+    }
+
+    PackedState pack(std::vector<std::size_t> const& boxes, std::size_t player) const {
+      PackedState state{std::vector<std::uint64_t>(words())};
+      pack(boxes, player, state.words.data());
+      return state;
+    }
+
+    // Sorted box cells
+    std::vector<std::size_t> boxes(std::uint64_t const* words) const {
+      std::vector<std::size_t> result;
+      for (std::size_t bit = 0; bit < cellOf.size(); ++bit) {
+	if (words[bit / 64] >> (bit % 64) & 1) result.push_back(cellOf[bit]);
+      }
+      return result;
+    }
+
+    std::vector<std::size_t> boxes(PackedState const& state) const { return boxes(state.words.data()); }
+
+    std::size_t player(std::uint64_t const* words) const { return static_cast<std::size_t>(words[this->words() - 1]); }
+    std::size_t player(PackedState const& state) const { return player(state.words.data()); }
+
+    // The box bits rounded up to bytes, then the player as a 4 byte
+    // interior index, little endian either way
+    std::string serialize(PackedState const& state) const {
+      std::string bytes(serializedBytes(), '\0');
+      std::size_t boxBytes = (cellOf.size() + 7) / 8;
+      for (std::size_t i = 0; i < boxBytes; ++i) {
+	bytes[i] = static_cast<char>(state.words[i / 8] >> (i % 8 * 8) & 0xff);
+      }
+      std::uint32_t bit = bitOf[player(state)];
+      for (std::size_t i = 0; i < 4; ++i) {
+	bytes[boxBytes + i] = static_cast<char>(bit >> (i * 8) & 0xff);
+      }
+      return bytes;
+    }
+
+    // False when bytes weren't made by serialize() for this level
+    bool deserialize(std::string const& bytes, PackedState& state) const {
+      if (bytes.size() != serializedBytes()) return false;
+      state.words.assign(words(), 0);
+      std::size_t boxBytes = (cellOf.size() + 7) / 8;
+      for (std::size_t i = 0; i < boxBytes; ++i) {
+	state.words[i / 8] |= std::uint64_t{static_cast<unsigned char>(bytes[i])} << (i % 8 * 8);
+      }
+      if (cellOf.size() % 64 != 0 && state.words[words() - 2] >> (cellOf.size() % 64) != 0) return false;
+      std::uint32_t bit = 0;
+      for (std::size_t i = 0; i < 4; ++i) {
+	bit |= std::uint32_t{static_cast<unsigned char>(bytes[boxBytes + i])} << (i * 8);
+      }
+      if (bit >= cellOf.size()) return false;
+      state.words[words() - 1] = cellOf[bit];
+      return true;
+    }
+
+    std::size_t serializedBytes() const { return (cellOf.size() + 7) / 8 + 4; }
+
+  private:
+    static std::uint32_t none() { return std::numeric_limits<std::uint32_t>::max(); }
+
+    std::vector<std::uint32_t> bitOf;  // cell -> bit, none() outside
+    std::vector<std::size_t> cellOf;   // bit -> cell
+  };
+
+  // Packed states back to back in one buffer, each stored once and named
+  // by its position. The set only holds ids and reads the words through
+  // the table, so it can't be copied.
+  class StateTable {
+  public:
+    explicit StateTable(std::size_t words)
+      : stride(words), ids(0, Hash{this}, Equal{this}) {}
+
+    StateTable(StateTable const&) = delete;
+    StateTable& operator=(StateTable const&) = delete;
+
+    // The id of the state, and whether it is new
+    std::pair<std::size_t, bool> insert(std::uint64_t const* state) {
+      std::size_t id = size();
+      buffer.insert(buffer.end(), state, state + stride);
+      auto result = ids.insert(id);
+      if (!result.second) buffer.resize(buffer.size() - stride);
+      return {*result.first, result.second};
+    }
+
+    std::uint64_t const* operator[](std::size_t id) const { return buffer.data() + id * stride; }
+
+    std::size_t size() const { return buffer.size() / stride; }
+
+    // Buffer plus the set's nodes and buckets, as libstdc++ lays them out
+    std::size_t bytes() const {
+      return buffer.capacity() * sizeof(std::uint64_t)
+	+ ids.size() * (sizeof(std::size_t) + 2 * sizeof(void*)) + ids.bucket_count() * sizeof(void*);
+    }
+
+  private:
+    struct Hash {
+      StateTable const* table;
+      std::size_t operator()(std::size_t id) const { return hashWords((*table)[id], table->stride); }
+    };
+
+    struct Equal {
+      StateTable const* table;
+      bool operator()(std::size_t a, std::size_t b) const {
+	return std::equal((*table)[a], (*table)[a] + table->stride, (*table)[b]);
+      }
+    };
+
+    std::size_t stride;
+    std::vector<std::uint64_t> buffer;
+    std::unordered_set<std::size_t, Hash, Equal> ids;
+  };
+
+  class Solver {
+  public:
+    explicit Solver(Level const& level) : Solver(TileGrid{level}) {}
+
+    explicit Solver(TileGrid const& tiles)
+      : width(tiles.width), height(tiles.height), walls(tiles.width * tiles.height, false),
+	goals(tiles.width * tiles.height, false), states(tiles)
+    {
+      for (std::size_t y = 0; y < height; ++y) {
+	for (std::size_t x = 0; x < width; ++x) {
+	  auto cell = tiles.at(x, y);
+	  auto index = tiles.index(x, y);
+	  walls[index] = (cell & TileGrid::Wall) != 0;
+	  goals[index] = (cell & TileGrid::Goal) != 0;
+	  if (cell & TileGrid::Goal) ++goalCount;
+	  if (cell & TileGrid::Box) startBoxes.push_back(index);
+	}
+      }
+      startPlayer = tiles.playerCell();
+      computePushDistances();
+    }
+
+    // Gives up after maxExpanded states, with solved and exhausted both false
+    Solution solve(std::size_t maxExpanded = 1000000) {
+      auto begin = std::chrono::steady_clock::now();
+      Solution solution;
+      search(solution, maxExpanded);
+      solution.stats.milliseconds =
+	std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+      return solution;
+    }
+
+    // Cells from which a box can never be pushed onto a goal
+    bool isDead(std::size_t cell) const { return pushDistance[cell] == unreachable(); }
+
+    StateCodec const& codec() const { return states; }
+
+    PackedState startState() {
+      return states.pack(startBoxes, normalizedPlayer(startBoxes, startPlayer));
+    }
+
+  private:
+    static std::size_t unreachable() { return std::numeric_limits<std::size_t>::max(); }
+
+    // Direction 0 up, 1 down, 2 left, 3 right
+    static char letter(int direction, bool push) { return (push ? "UDLR" : "udlr")[direction]; }
+
+    struct Node {
+      std::size_t state; // id in the StateTable
+      std::size_t parent;
+      std::size_t box;  // cell of the pushed box before the push
+      int direction;
+      std::size_t pushes;
+    };
+
+    // False when the step leaves the grid
+    bool step(std::size_t from, int direction, std::size_t& to) const {
+      std::size_t x = from % width;
+      std::size_t y = from / width;
+      switch (direction) {
+      case 0: if (y == 0) return false; to = from - width; return true;
+      case 1: if (y + 1 >= height) return false; to = from + width; return true;
+      case 2: if (x == 0) return false; to = from - 1; return true;
+      default: if (x + 1 >= width) return false; to = from + 1; return true;
+      }
+    }
+
+    static int opposite(int direction) { return direction ^ 1; }
+
+    bool hasBox(std::vector<std::size_t> const& boxes, std::size_t cell) const {
+      return std::binary_search(boxes.begin(), boxes.end(), cell);
+    }
+
+    // cells[cell] == stamp marks a cell, so the buffer is only cleared
+    // once every 2^32 fills
+    struct Marks {
+      std::vector<std::uint32_t> cells;
+      std::uint32_t stamp{0};
+
+      bool has(std::size_t cell) const { return cells[cell] == stamp; }
+    };
+
+    // Flood fill of the cells the player can walk to
+    void flood(std::vector<std::size_t> const& boxes, std::size_t from, Marks& marks) {
+      if (marks.cells.size() != walls.size()) marks.cells.assign(walls.size(), 0);
+      if (++marks.stamp == 0) {
+	std::fill(marks.cells.begin(), marks.cells.end(), 0);
+	marks.stamp = 1;
+      }
+      queue.clear();
+      queue.push_back(from);
+      marks.cells[from] = marks.stamp;
+      for (std::size_t i = 0; i < queue.size(); ++i) {
+	for (int d = 0; d < 4; ++d) {
+	  std::size_t next;
+	  if (step(queue[i], d, next) && !marks.has(next) && !walls[next] && !hasBox(boxes, next)) {
+	    marks.cells[next] = marks.stamp;
+	    queue.push_back(next);
+	  }
+	}
+      }
+    }
+
+    std::size_t normalizedPlayer(std::vector<std::size_t> const& boxes, std::size_t from) {
+      flood(boxes, from, reached);
+      return *std::min_element(queue.begin(), queue.end());
+    }
+
+    // Backwards from every goal: a box at c can come from c - d when the
+    // player has room to stand at c - 2d to push it
+    void computePushDistances() {
+      pushDistance.assign(walls.size(), unreachable());
+      std::vector<std::size_t> frontier;
+      for (std::size_t cell = 0; cell < goals.size(); ++cell) {
+	if (goals[cell] && !walls[cell]) {
+	  pushDistance[cell] = 0;
+	  frontier.push_back(cell);
+	}
+      }
+      for (std::size_t i = 0; i < frontier.size(); ++i) {
+	std::size_t cell = frontier[i];
+	for (int d = 0; d < 4; ++d) {
+	  std::size_t from, stand;
+	  if (!step(cell, d, from) || !step(from, d, stand)) continue;
+	  if (walls[from] || walls[stand] || pushDistance[from] != unreachable()) continue;
+	  pushDistance[from] = pushDistance[cell] + 1;
+	  frontier.push_back(from);
+	}
+      }
+    }
+
+    std::size_t heuristic(std::vector<std::size_t> const& boxes) const {
+      std::size_t h = 0;
+      for (auto box : boxes) h += pushDistance[box];
+      return h;
+    }
+
+    bool solved(std::vector<std::size_t> const& boxes) const {
+      for (auto box : boxes) {
+	if (!goals[box]) return false;
+      }
+      return true;
+    }
+
+    std::size_t estimateBytes(std::vector<Node> const& nodes, std::size_t openSize, StateTable const& table,
+			      std::vector<std::size_t> const& fewestPushes) const {
+      return nodes.capacity() * sizeof(Node) + openSize * sizeof(std::pair<std::size_t, std::size_t>)
+	+ table.bytes() + fewestPushes.capacity() * sizeof(std::size_t);
+    }
+
+    void search(Solution& solution, std::size_t maxExpanded) {
+      auto& stats = solution.stats;
+      stats.bytesPerState = states.bytesPerState();
+      if (startBoxes.size() > goalCount) {
+	solution.exhausted = true;
+	return;
+      }
+      for (auto box : startBoxes) {
+	if (isDead(box)) {
+	  solution.exhausted = true;
+	  return;
+	}
+      }
+
+      std::vector<Node> nodes;
+      StateTable table{states.words()};
+      std::vector<std::size_t> fewestPushes; // by state id
+      std::vector<std::uint64_t> packed(states.words());
+      // (f, node), smallest f first; ties go to the deepest node
+      using Entry = std::pair<std::size_t, std::size_t>;
+      auto later = [&](Entry const& a, Entry const& b) {
+	if (a.first != b.first) return a.first > b.first;
+	return nodes[a.second].pushes < nodes[b.second].pushes;
+      };
+      std::priority_queue<Entry, std::vector<Entry>, decltype(later)> open(later);
+
+      states.pack(startBoxes, normalizedPlayer(startBoxes, startPlayer), packed.data());
+      nodes.push_back({table.insert(packed.data()).first, 0, 0, 0, 0});
+      fewestPushes.push_back(0);
+      open.emplace(heuristic(startBoxes), 0);
+      stats.generated = 1;
+
+      while (!open.empty()) {
+	std::size_t current = open.top().second;
+	open.pop();
+
+	// stale entry: this state was reached with fewer pushes since
+	if (fewestPushes[nodes[current].state] < nodes[current].pushes) continue;
+
+	// sorted, since bits follow cell order
+	auto boxes = states.boxes(table[nodes[current].state]);
+	if (solved(boxes)) {
+	  // a push chain the player can't walk is a solver bug: report no solution
+	  solution.solved = replay(nodes, current, solution.moves);
+	  if (solution.solved) solution.pushes = nodes[current].pushes;
+	  else solution.moves.clear();
+	  stats.peakBytes = std::max(stats.peakBytes, estimateBytes(nodes, open.size(), table, fewestPushes));
+	  return;
+	}
+	if (stats.expanded == maxExpanded) {
+	  stats.peakBytes = std::max(stats.peakBytes, estimateBytes(nodes, open.size(), table, fewestPushes));
+	  return;
+	}
+	++stats.expanded;
+
+	auto pushes = nodes[current].pushes + 1;
+	// its own buffer: normalizing the children floods reached
+	flood(boxes, states.player(table[nodes[current].state]), walkable);
+
+	for (std::size_t b = 0; b < boxes.size(); ++b) {
+	  for (int d = 0; d < 4; ++d) {
+	    std::size_t stand, target;
+	    if (!step(boxes[b], opposite(d), stand) || !walkable.has(stand)) continue;
+	    if (!step(boxes[b], d, target) || walls[target] || isDead(target) || hasBox(boxes, target)) continue;
+
+	    auto next = boxes;
+	    next[b] = target;
+	    std::sort(next.begin(), next.end());
+	    states.pack(next, normalizedPlayer(next, boxes[b]), packed.data());
+
+	    auto inserted = table.insert(packed.data());
+	    if (inserted.second) fewestPushes.push_back(pushes);
+	    else if (fewestPushes[inserted.first] <= pushes) continue;
+	    else fewestPushes[inserted.first] = pushes;
+
+	    auto h = heuristic(next);
+	    nodes.push_back({inserted.first, current, boxes[b], d, pushes});
+	    open.emplace(pushes + h, nodes.size() - 1);
+	    ++stats.generated;
+	  }
+	}
+	stats.peakBytes = std::max(stats.peakBytes, estimateBytes(nodes, open.size(), table, fewestPushes));
+      }
+
+      solution.exhausted = true;
+    }
+
+    // Walks the player from push to push along shortest paths. False when
+    // a push can't be reached, which the search should never produce.
+    bool replay(std::vector<Node> const& nodes, std::size_t last, std::string& moves) {
+      std::vector<std::size_t> chain;
+      for (std::size_t n = last; n != 0; n = nodes[n].parent) chain.push_back(n);
+      std::reverse(chain.begin(), chain.end());
+
+      auto boxes = startBoxes;
+      std::size_t player = startPlayer;
+      for (auto n : chain) {
+	auto const& node = nodes[n];
+	std::size_t stand = node.box;
+	step(node.box, opposite(node.direction), stand);
+	if (!walk(boxes, player, stand, moves)) return false;
+	moves += letter(node.direction, true);
+
+	std::size_t target = node.box;
+	step(node.box, node.direction, target);
+	*std::find(boxes.begin(), boxes.end(), node.box) = target;
+	std::sort(boxes.begin(), boxes.end());
+	player = node.box;
+      }
+      return true;
+    }
+
+    // Appends the shortest walk between two cells as LURD letters, false
+    // when to can't be reached
+    bool walk(std::vector<std::size_t> const& boxes, std::size_t from, std::size_t to, std::string& moves) {
+      std::vector<int> cameFrom(walls.size(), -1);
+      std::vector<std::size_t> frontier{from};
+      cameFrom[from] = 4;
+      for (std::size_t i = 0; i < frontier.size() && cameFrom[to] < 0; ++i) {
+	for (int d = 0; d < 4; ++d) {
+	  std::size_t next;
+	  if (step(frontier[i], d, next) && cameFrom[next] < 0 && !walls[next] && !hasBox(boxes, next)) {
+	    cameFrom[next] = d;
+	    frontier.push_back(next);
+	  }
+	}
+      }
+
+      assert(cameFrom[to] >= 0 && "replayed push out of the player's reach");
+      if (cameFrom[to] < 0) return false;
+
+      std::string path;
+      for (std::size_t cell = to; cell != from;) {
+	int d = cameFrom[cell];
+	path += letter(d, false);
+	step(cell, opposite(d), cell);
+      }
+      moves.append(path.rbegin(), path.rend());
+      return true;
+    }
+
+    std::size_t width;
+    std::size_t height;
+    std::vector<bool> walls;
+    std::vector<bool> goals;
+    std::size_t goalCount{0};
+    std::vector<std::size_t> pushDistance;
+
+    StateCodec states;
+    std::vector<std::size_t> startBoxes;
+    std::size_t startPlayer{0};
+
+    Marks reached;
+    Marks walkable;
+    std::vector<std::size_t> queue;
+  };
+
+}
+
+#endif /* SOLVER_H */
@@ -0,0 +1,114 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running one parallel loop at a time. The
+// calling thread works too, so a pool of size 1 has no workers and runs
+// everything inline.
+class ThreadPool {
+public:
+  explicit ThreadPool(std::size_t threads = std::thread::hardware_concurrency()) {
+    for (std::size_t i = 1; i < threads; ++i) {
+      workers.emplace_back([this] { workerLoop(); });
+    }
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) worker.join();
+  }
+
+  ThreadPool(ThreadPool const&) = delete;
+  ThreadPool& operator=(ThreadPool const&) = delete;
+
+  std::size_t size() const { return workers.size() + 1; }
+
+  // Calls f(i) for every i in [0, tasks) and returns once all of them ran.
+  // Tasks are handed out one at a time, in no particular order.
+  void run(std::size_t tasks, std::function<void(std::size_t)> f) {
+    if (tasks == 0) return;
+    if (workers.empty() || tasks == 1) {
+      for (std::size_t i = 0; i < tasks; ++i) f(i);
+      return;
+    }
+
+    {
+      // a late worker may still be checking the previous run's counters
+      std::unique_lock<std::mutex> lock(mutex);
+      done.wait(lock, [this] { return active == 0; });
+      job = std::move(f);
+      taskCount = tasks;
+      next = 0;
+      remaining = tasks;
+      ++generation;
+    }
+    wake.notify_all();
+
+    work();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return remaining == 0 && active == 0; });
+    job = nullptr;
+  }
+
+private:
+  void workerLoop() {
+    std::size_t seen = 0;
+    for (;;) {
+      {
+	std::unique_lock<std::mutex> lock(mutex);
+	wake.wait(lock, [&] { return stopping || generation != seen; });
+	if (stopping) return;
+	seen = generation;
+	++active;
+      }
+
+      work();
+
+      {
+	std::lock_guard<std::mutex> lock(mutex);
+	--active;
+      }
+      done.notify_all();
+    }
+  }
+
+  void work() {
+    for (;;) {
+      std::size_t i = next.fetch_add(1);
+      if (i >= taskCount) return;
+      job(i);
+      if (remaining.fetch_sub(1) == 1) {
+	std::lock_guard<std::mutex> lock(mutex);
+	done.notify_all();
+      }
+    }
+  }
+
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+
+  std::function<void(std::size_t)> job;
+  std::size_t taskCount{0};
+  std::atomic<std::size_t> next{0};
+  std::atomic<std::size_t> remaining{0};
+  std::size_t generation{0};
+  std::size_t active{0};
+  bool stopping{false};
+};
+
+#endif /* THREAD_POOL_H */
@@ -0,0 +1,99 @@
+#ifndef TILE_GRID_H
+#define TILE_GRID_H
+
+#include <cstdint>
+#include <vector>
+
+#include "level.hpp"
+
+// Discrete sokoban rules over a packed occupancy grid, one byte of flags
+// per tile. A step or a push only looks at the next two cells, so its cost
+// doesn't depend on how many objects the level has.
+class TileGrid {
+public:
+  enum Cell : std::uint8_t { Empty = 0, Wall = 1, Box = 2, Goal = 4 };
+
+  enum class Move { Blocked, Walked, Pushed };
+
+  struct MoveResult {
+    Move move{Move::Blocked};
+    std::size_t boxFrom{0}; // cell indices, only set when a box was pushed
+    std::size_t boxTo{0};
+  };
+
+  explicit TileGrid(Level const& level)
+    : width(level.width), height(level.height), cells(level.width * level.height, Empty)
+  {
+    for (auto const& obj : level.objects) {
+      auto x = static_cast<std::size_t>(obj.rect.x) / constants::tile_width;
+      auto y = static_cast<std::size_t>(obj.rect.y) / constants::tile_height;
+      if (x >= width || y >= height) continue;
+      if (obj.tex == TextureType::Wall) cells[index(x, y)] |= Wall;
+      if (obj.tex == TextureType::Box) cells[index(x, y)] |= Box;
+    }
+    for (auto const& goal : level.goals) {
+      cells[index(static_cast<std::size_t>(goal.x), static_cast<std::size_t>(goal.y))] |= Goal;
+    }
+    for (auto cell : cells) {
+      if ((cell & Box) && !(cell & Goal)) ++boxesOffGoal;
+    }
+    player = index(static_cast<std::size_t>(level.playerStartPosition.x),
+		   static_cast<std::size_t>(level.playerStartPosition.y));
+  }
+
+  // Moves the player one tile, pushing a box if there is room behind it.
+  // Leaving the grid counts as blocked.
+  MoveResult move(int dx, int dy) {
+    MoveResult result;
+    std::size_t next, beyond;
+    if (!step(player, dx, dy, next) || (cells[next] & Wall))
+      return result;
+
+    if (cells[next] & Box) {
+      if (!step(next, dx, dy, beyond) || (cells[beyond] & (Wall | Box)))
+	return result;
+
+      cells[next] = static_cast<std::uint8_t>(cells[next] & ~Box);
+      cells[beyond] |= Box;
+      if (cells[next] & Goal) ++boxesOffGoal;
+      if (cells[beyond] & Goal) --boxesOffGoal;
+
+      result.move = Move::Pushed;
+      result.boxFrom = next;
+      result.boxTo = beyond;
+    } else {
+      result.move = Move::Walked;
+    }
+
+    player = next;
+    return result;
+  }
+
+  bool solved() const { return boxesOffGoal == 0; }
+
+  std::uint8_t at(std::size_t x, std::size_t y) const { return cells[index(x, y)]; }
+  std::size_t index(std::size_t x, std::size_t y) const { return x + width * y; }
+  std::size_t column(std::size_t cell) const { return cell % width; }
+  std::size_t row(std::size_t cell) const { return cell / width; }
+
+  std::size_t playerCell() const { return player; }
+
+  std::size_t width;
+  std::size_t height;
+
+private:
+  bool step(std::size_t from, int dx, int dy, std::size_t& to) const {
+    auto x = static_cast<long long>(column(from)) + dx;
+    auto y = static_cast<long long>(row(from)) + dy;
+    if (x < 0 || y < 0 || x >= static_cast<long long>(width) || y >= static_cast<long long>(height))
+      return false;
+    to = index(static_cast<std::size_t>(x), static_cast<std::size_t>(y));
+    return true;
+  }
+
+  std::vector<std::uint8_t> cells;
+  std::size_t player{0};
+  std::size_t boxesOffGoal{0};
+};
+
+#endif /* TILE_GRID_H */
@@ -0,0 +1,271 @@
+#define CATCH_CONFIG_MAIN
+
+#include "catch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/collisions.hpp"
+
+// Differential tests: GJK and EPA against a brute force SAT on seeded
+// random shapes. Set SOKOBAN_FUZZ_SEED and SOKOBAN_FUZZ_ITERATIONS to run
+// longer or replay a case; failures and outliers print the case seed.
+
+namespace {
+
+  std::uint32_t environment(char const* name, std::uint32_t fallback) {
+    char const* value = std::getenv(name);
+    return value ? static_cast<std::uint32_t>(std::stoul(value)) : fallback;
+  }
+
+  std::uint32_t const baseSeed = environment("SOKOBAN_FUZZ_SEED", 1);
+  std::uint32_t const iterations = environment("SOKOBAN_FUZZ_ITERATIONS", 20000);
+
+  struct Reference {
+    float depth; // smallest overlap over every axis, negative when separated
+    Vec2 axis;
+  };
+
+  // Tries the normal of every edge of both shapes, plus the direction of
+  // segments so that collinear shapes still get a separating axis
+  Reference bruteForceSAT(std::vector<Vec2> const& shape1, std::vector<Vec2> const& shape2) {
+    std::vector<Vec2> axes;
+    for (auto const* shape : {&shape1, &shape2}) {
+      for (std::size_t i = 0; i < shape->size(); ++i) {
+	Vec2 e = (*shape)[(i + 1) % shape->size()] - (*shape)[i];
+	if (glm::length(e) == 0.f) continue;
+	axes.push_back(glm::normalize(Vec2{e.y, -e.x}));
+	axes.push_back(glm::normalize(e));
+      }
+    }
+    if (axes.empty()) axes.push_back(Vec2{1.f, 0.f});
+
+    Reference best{std::numeric_limits<float>::max(), Vec2{0.f, 0.f}};
+    for (Vec2 axis : axes) {
+      float min1 = std::numeric_limits<float>::max(), max1 = -min1;
+      float min2 = min1, max2 = -min1;
+      for (Vec2 p : shape1) {
+	min1 = std::min(min1, glm::dot(p, axis));
+	max1 = std::max(max1, glm::dot(p, axis));
+      }
+      for (Vec2 p : shape2) {
+	min2 = std::min(min2, glm::dot(p, axis));
+	max2 = std::max(max2, glm::dot(p, axis));
+      }
+      float overlap = std::min(max1 - min2, max2 - min1);
+      if (overlap < best.depth) best = {overlap, axis};
+    }
+    return best;
+  }
+
+  // How far shape1 has to move along -normal to clear shape2
+  float overlapAlong(std::vector<Vec2> const& shape1, std::vector<Vec2> const& shape2, Vec2 normal) {
+    float max1 = -std::numeric_limits<float>::max();
+    float min2 = std::numeric_limits<float>::max();
+    for (Vec2 p : shape1) max1 = std::max(max1, glm::dot(p, normal));
+    for (Vec2 p : shape2) min2 = std::min(min2, glm::dot(p, normal));
+    return max1 - min2;
+  }
+
+  std::vector<Vec2> randomPolygon(std::mt19937& rng, Vec2 center, float radius) {
+    std::uniform_real_distribution<float> angle(0.f, 6.2831853f);
+    std::uniform_real_distribution<float> spread(0.5f, 1.f);
+    std::uniform_int_distribution<int> count(3, 12);
+    std::vector<Vec2> points;
+    for (int i = count(rng); i > 0; --i) {
+      float a = angle(rng);
+      float r = radius * spread(rng);
+      points.emplace_back(center.x + r * std::cos(a), center.y + r * std::sin(a));
+    }
+    return collision::ConvexPolygon{points}.points();
+  }
+
+  enum class Family { Random, Touching, Contained, Segment, Duplicated };
+
+  struct Case {
+    std::uint32_t seed;
+    Family family;
+    std::vector<Vec2> shape1;
+    std::vector<Vec2> shape2;
+  };
+
+  Case makeCase(std::uint32_t seed) {
+    std::mt19937 rng{seed};
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+    std::uniform_real_distribution<float> scale(0.5f, 200.f);
+    std::uniform_int_distribution<int> family(0, 4);
+
+    Case c{seed, static_cast<Family>(family(rng)), {}, {}};
+    float size = scale(rng);
+    Vec2 center{unit(rng) * 1000.f, unit(rng) * 1000.f};
+    c.shape1 = randomPolygon(rng, center, size);
+
+    switch (c.family) {
+    case Family::Random:
+      c.shape2 = randomPolygon(rng, center + Vec2{unit(rng), unit(rng)} * size * 2.f, scale(rng));
+      break;
+    case Family::Touching: {
+      // a copy moved exactly out along one of its edge normals
+      c.shape2 = c.shape1;
+      auto reference = bruteForceSAT(c.shape1, c.shape2);
+      Vec2 shift = reference.axis * reference.depth;
+      for (auto& p : c.shape2) p += shift;
+    } break;
+    case Family::Contained:
+      c.shape2 = randomPolygon(rng, center + Vec2{unit(rng), unit(rng)} * size * 0.1f, size * 0.2f);
+      break;
+    case Family::Segment: {
+      Vec2 a = center + Vec2{unit(rng), unit(rng)} * size * 2.f;
+      c.shape2 = {a, a + Vec2{unit(rng), unit(rng)} * size * 2.f};
+    } break;
+    case Family::Duplicated: {
+      c.shape2 = randomPolygon(rng, center + Vec2{unit(rng), unit(rng)} * size, size);
+      auto copy = c.shape2;
+      c.shape2.insert(c.shape2.end(), copy.begin(), copy.end());
+      std::rotate(c.shape2.begin(), c.shape2.begin() + 1, c.shape2.end());
+    } break;
+    }
+    return c;
+  }
+
+  bool finite(Vec2 v) { return std::isfinite(v.x) && std::isfinite(v.y); }
+
+  float extent(std::vector<Vec2> const& shape) {
+    float e = 1.f;
+    for (Vec2 p : shape) e = std::max(e, std::max(std::abs(p.x), std::abs(p.y)));
+    return e;
+  }
+
+}
+
+TEST_CASE("GJK against brute force SAT", "[fuzz]") {
+  std::size_t disagreements = 0;
+  std::size_t maxSupports = 0;
+  std::uint32_t maxSupportsSeed = 0;
+
+  for (std::uint32_t i = 0; i < iterations; ++i) {
+    auto c = makeCase(baseSeed + i);
+    auto reference = bruteForceSAT(c.shape1, c.shape2);
+    // float noise grows with the coordinates, calls closer than this are touching
+    float epsilon = 1e-4f * std::max(extent(c.shape1), extent(c.shape2));
+
+    collision::GJKState state;
+    auto res = collision::GJK(collision::ShapeView{c.shape1}, collision::ShapeView{c.shape2}, state);
+    if (state.supports > maxSupports) {
+      maxSupports = state.supports;
+      maxSupportsSeed = c.seed;
+    }
+
+    if (std::abs(reference.depth) > epsilon && res.second != (reference.depth > 0)) {
+      ++disagreements;
+      std::cout << "GJK disagrees with SAT, seed " << c.seed << " depth " << reference.depth << "\n";
+    }
+  }
+
+  std::cout << "GJK: most support points " << maxSupports << " (seed " << maxSupportsSeed << ")\n";
+  REQUIRE(disagreements == 0);
+  REQUIRE(maxSupports < 64);
+}
+
+TEST_CASE("EPA against brute force SAT", "[fuzz]") {
+  std::size_t wrongDepth = 0;
+  std::size_t notFinite = 0;
+  std::size_t unconverged = 0;
+  std::size_t overlapping = 0;
+  std::size_t maxIterations = 0;
+  std::uint32_t maxIterationsSeed = 0;
+
+  for (std::uint32_t i = 0; i < iterations; ++i) {
+    auto c = makeCase(baseSeed + i);
+    collision::ShapeView view1{c.shape1};
+    collision::ShapeView view2{c.shape2};
+
+    auto res = collision::GJK(view1, view2);
+    if (!res.second) continue;
+    ++overlapping;
+
+    auto penetration = collision::EPA(view1, view2, res.first);
+    if (!finite(penetration.normal) || !std::isfinite(penetration.depth)) {
+      ++notFinite;
+      std::cout << "EPA returned NaN or inf, seed " << c.seed << "\n";
+      continue;
+    }
+    if (penetration.iterations > maxIterations) {
+      maxIterations = penetration.iterations;
+      maxIterationsSeed = c.seed;
+    }
+    if (!penetration.converged) {
+      ++unconverged;
+      continue;
+    }
+
+    // segments have no area: only ask for a finite answer
+    if (c.family == Family::Segment) continue;
+
+    auto reference = bruteForceSAT(c.shape1, c.shape2);
+    float epsilon = 1e-3f * std::max(extent(c.shape1), extent(c.shape2));
+    bool depthMatches = std::abs(penetration.depth - reference.depth) <= epsilon;
+    // moving shape1 back along the normal by depth has to separate them
+    bool normalMatches = penetration.depth <= epsilon
+      || std::abs(overlapAlong(c.shape1, c.shape2, penetration.normal) - penetration.depth) <= epsilon;
+    if (!depthMatches || !normalMatches) {
+      ++wrongDepth;
+      std::cout << "EPA depth " << penetration.depth << " against " << reference.depth << ", seed " << c.seed << "\n";
+    }
+  }
+
+  std::cout << "EPA: " << overlapping << " overlapping, " << unconverged << " unconverged, most iterations "
+	    << maxIterations << " (seed " << maxIterationsSeed << ")\n";
+  REQUIRE(overlapping > 0);
+  REQUIRE(notFinite == 0);
+  REQUIRE(wrongDepth == 0);
+  REQUIRE(unconverged * 100 <= overlapping);
+}
+
+TEST_CASE("MPR against brute force SAT", "[fuzz]") {
+  std::size_t disagreements = 0;
+  std::size_t wrongNormal = 0;
+
+  for (std::uint32_t i = 0; i < iterations; ++i) {
+    auto c = makeCase(baseSeed + i);
+    auto reference = bruteForceSAT(c.shape1, c.shape2);
+    float epsilon = 1e-3f * std::max(extent(c.shape1), extent(c.shape2));
+
+    auto contact = collision::MPR(collision::ShapeView{c.shape1}, collision::ShapeView{c.shape2});
+    if (std::abs(reference.depth) > epsilon && contact.collides != (reference.depth > 0)) {
+      ++disagreements;
+      std::cout << "MPR disagrees with SAT, seed " << c.seed << " depth " << reference.depth << "\n";
+      continue;
+    }
+    if (!contact.collides || c.family == Family::Segment) continue;
+
+    // not the smallest push, but a push that separates the shapes
+    bool separates = finite(contact.normal) && contact.depth >= reference.depth - epsilon
+      && std::abs(overlapAlong(c.shape1, c.shape2, contact.normal) - contact.depth) <= epsilon;
+    if (!separates) {
+      ++wrongNormal;
+      std::cout << "MPR depth " << contact.depth << " against " << reference.depth << ", seed " << c.seed << "\n";
+    }
+  }
+
+  REQUIRE(disagreements == 0);
+  REQUIRE(wrongNormal == 0);
+}
+
+TEST_CASE("Seeds that used to fail", "[fuzz]") {
+  // touching copies where GJK flipped between two triangles forever
+  for (std::uint32_t seed : {127811u, 237006u}) {
+    auto c = makeCase(seed);
+    collision::GJKState state;
+    auto res = collision::GJK(collision::ShapeView{c.shape1}, collision::ShapeView{c.shape2}, state);
+    REQUIRE_FALSE(res.second);
+    REQUIRE(state.supports < 64);
+  }
+}
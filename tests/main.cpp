@@ -3,6 +3,14 @@
 #include "catch.hpp"
 
 #include "../src/collisions.hpp"
+#include "../src/overlap_batch.hpp"
+#include "../src/broadphase.hpp"
+#include "../src/manifold.hpp"
+#include "../src/tile_grid.hpp"
+#include "../src/parallel_narrowphase.hpp"
+#include "../src/raycast.hpp"
+#include "../src/sleeping.hpp"
+#include "../src/solver.hpp"
 
 TEST_CASE("Collisions", "[collisions]") {
   std::vector<Vec2> shape1{Vec2{4, 11}, Vec2{9, 9}, Vec2{4, 5}};
@@ -20,4 +28,1185 @@ TEST_CASE("Collisions", "[collisions]") {
 
     REQUIRE(response.second == false);
   }
+
+  SECTION("Views over fixed-size buffers") {
+    std::array<Vec2, 3> fixed1{{Vec2{4, 11}, Vec2{9, 9}, Vec2{4, 5}}};
+    collision::ShapeView view2{shape2.data(), shape2.size()};
+
+    auto response = collision::GJK(collision::ShapeView{fixed1}, view2);
+
+    REQUIRE(response.second == true);
+    REQUIRE(response.first.size() == 3);
+    REQUIRE(collision::GJK(collision::ShapeView{fixed1}, collision::ShapeView{shape3}).second == false);
+
+    auto penetration = collision::EPA(fixed1, view2, response.first);
+    REQUIRE(penetration.depth > 0.f);
+  }
+}
+
+TEST_CASE("AABB collisions", "[collisions]") {
+  Vec4 rect1{0, 0, 64, 64};
+
+  SECTION("Penetration along the axis of least overlap") {
+    auto contact = collision::AABB(rect1, Vec4{60, 10, 64, 64});
+
+    REQUIRE(contact.collides == true);
+    REQUIRE(contact.normal == Vec2(1, 0));
+    REQUIRE(contact.depth == Approx(4));
+
+    contact = collision::AABB(rect1, Vec4{10, -62, 64, 64});
+
+    REQUIRE(contact.collides == true);
+    REQUIRE(contact.normal == Vec2(0, -1));
+    REQUIRE(contact.depth == Approx(2));
+  }
+
+  SECTION("Touching and separated rects") {
+    REQUIRE(collision::AABB(rect1, Vec4{64, 0, 64, 64}).collides == false);
+    REQUIRE(collision::AABB(rect1, Vec4{100, 100, 64, 64}).collides == false);
+  }
+
+  SECTION("Agrees with GJK") {
+    for (float x = -80; x <= 80; x += 8) {
+      for (float y = -80; y <= 80; y += 8) {
+	Vec4 rect2{x, y, 48, 48};
+	REQUIRE(collision::AABB(rect1, rect2).collides == collision::GJK(rect1, rect2).second);
+      }
+    }
+  }
+}
+
+TEST_CASE("Hill-climbing support on convex polygons", "[collisions]") {
+  std::vector<Vec2> points;
+  for (int i = 0; i < 300; ++i) {
+    float angle = static_cast<float>((i * 7919) % 300) * 6.2831853f / 300;
+    float radius = 40.f + static_cast<float>((i * 31) % 17);
+    points.push_back(Vec2{std::cos(angle), std::sin(angle)} * radius);
+  }
+  collision::ConvexPolygon polygon{points};
+  std::vector<Vec2> const& hull = polygon.points();
+
+  REQUIRE(hull.size() >= 32);
+  REQUIRE(hull.size() < points.size());
+
+  SECTION("Agrees with the linear scan") {
+    collision::ShapeView climbing = polygon;
+    collision::ShapeView scanning{hull};
+    for (int i = 0; i < 720; ++i) {
+      float angle = static_cast<float>((i * 37) % 720) * 6.2831853f / 720;
+      Vec2 direction{std::cos(angle), std::sin(angle)};
+      auto climbed = indexOfFurthestPoint(climbing, direction);
+      auto scanned = indexOfFurthestPoint(scanning, direction);
+      REQUIRE(glm::dot(direction, hull[climbed]) == Approx(glm::dot(direction, hull[scanned])));
+    }
+  }
+
+  SECTION("Plugs into GJK and EPA") {
+    std::vector<Vec2> moved = points;
+    for (auto& point : moved) point.x += 70.f;
+    collision::ConvexPolygon other{moved};
+
+    auto res = collision::GJK(polygon, other);
+    REQUIRE(res.second == true);
+    auto penetration = collision::EPA(polygon, other, res.first);
+    auto reference = collision::EPA(hull, other.points(), res.first);
+    REQUIRE(penetration.depth == Approx(reference.depth));
+
+    for (auto& point : moved) point.x += 60.f;
+    REQUIRE(collision::GJK(polygon, collision::ConvexPolygon{moved}).second == false);
+  }
+}
+
+TEST_CASE("Fixed-size GJK", "[collisions]") {
+  std::array<Vec2, 3> shape1{{Vec2{4, 11}, Vec2{9, 9}, Vec2{4, 5}}};
+  std::array<Vec2, 4> shape2{{Vec2{5, 7}, Vec2{12, 7}, Vec2{10, 2}, Vec2{7, 3}}};
+  std::array<Vec2, 3> shape3{{Vec2{-4, 11}, Vec2{-9, 9}, Vec2{-4, 5}}};
+
+  REQUIRE(indexOfFurthestPoint(shape2, Vec2{1, 0}) == 1);
+  REQUIRE(indexOfFurthestPoint(shape2, Vec2{0, -1}) == 2);
+
+  auto fixed = collision::GJK(shape1, shape2);
+  auto dynamic = collision::GJK(collision::ShapeView{shape1}, collision::ShapeView{shape2});
+  REQUIRE(fixed.second == true);
+  REQUIRE(fixed.first.size() == dynamic.first.size());
+  for (std::size_t i = 0; i < fixed.first.size(); ++i) {
+    REQUIRE(fixed.first[i] == dynamic.first[i]);
+  }
+
+  REQUIRE(collision::GJK(shape1, shape3).second == false);
+
+  for (float x = -80; x <= 80; x += 10) {
+    Vec4 rect1{0, 0, 64, 64};
+    Vec4 rect2{x, x / 2, 64, 32};
+    REQUIRE(collision::GJK(rect1, rect2).second == collision::AABB(rect1, rect2).collides);
+  }
+}
+
+TEST_CASE("GJK warm start", "[collisions]") {
+  std::vector<Vec2> shape1{Vec2{4, 11}, Vec2{9, 9}, Vec2{4, 5}};
+  std::vector<Vec2> shape2{Vec2{5, 7}, Vec2{12, 7}, Vec2{10, 2}, Vec2{7, 3}};
+  std::vector<Vec2> shape3{Vec2{-4, 11}, Vec2{-9, 9}, Vec2{-4, 5}};
+  collision::GJKCache cache;
+
+  SECTION("Resting separated pairs take a single support point") {
+    REQUIRE(cache.GJK(1, 3, shape1, shape3).second == false);
+    cache.resetStats();
+
+    for (int frame = 0; frame < 10; ++frame) {
+      REQUIRE(cache.GJK(1, 3, shape1, shape3).second == false);
+    }
+    REQUIRE(cache.queries() == 10);
+    REQUIRE(cache.averageSupports() == Approx(1));
+  }
+
+  SECTION("Cached directions don't change the answer") {
+    for (int frame = 0; frame < 10; ++frame) {
+      REQUIRE(cache.GJK(1, 2, shape1, shape2).second == true);
+      REQUIRE(cache.GJK(1, 3, shape1, shape3).second == false);
+    }
+    cache.forget(1, 2);
+    REQUIRE(cache.GJK(1, 2, shape1, shape2).second == true);
+  }
+}
+
+TEST_CASE("EPA penetration", "[collisions]") {
+  SECTION("Converges to the analytic depth on rects") {
+    Vec4 rect1{0, 0, 64, 64};
+    for (float x = -56; x <= 56; x += 8) {
+      for (float y = -60; y <= 60; y += 12) {
+	Vec4 rect2{x + 0.5f, y + 0.25f, 48, 48};
+	auto points1 = collision::rectToPoints(rect1);
+	auto points2 = collision::rectToPoints(rect2);
+	auto res = collision::GJK(collision::ShapeView{points1}, collision::ShapeView{points2});
+	auto expected = collision::AABB(rect1, rect2);
+	REQUIRE(res.second == expected.collides);
+	if (!res.second) continue;
+
+	auto penetration = collision::EPA(points1, points2, res.first);
+	REQUIRE(penetration.converged);
+	REQUIRE(penetration.depth == Approx(expected.depth).margin(1e-3));
+	REQUIRE(penetration.normal.x == Approx(expected.normal.x).margin(1e-4));
+	REQUIRE(penetration.normal.y == Approx(expected.normal.y).margin(1e-4));
+      }
+    }
+  }
+
+  SECTION("Iteration cap is honoured") {
+    std::vector<Vec2> circle1, circle2;
+    for (int i = 0; i < 64; ++i) {
+      float angle = static_cast<float>(i) * 6.2831853f / 64;
+      circle1.push_back(Vec2{std::cos(angle), std::sin(angle)} * 10.f);
+      circle2.push_back(Vec2{std::cos(angle) + 0.5f, std::sin(angle)} * 10.f);
+    }
+    auto res = collision::GJK(circle1, circle2);
+    REQUIRE(res.second == true);
+
+    collision::Polytope polytope;
+    for (std::size_t i = 0; i < res.first.size(); ++i) polytope.insert(i, res.first[i]);
+    auto capped = collision::EPA(circle1, circle2, polytope, 2);
+    REQUIRE(capped.iterations == 2);
+    REQUIRE(capped.converged == false);
+
+    auto full = collision::EPA(circle1, circle2, res.first);
+    REQUIRE(full.converged);
+    REQUIRE(full.depth == Approx(15).epsilon(0.01));
+  }
+}
+
+TEST_CASE("GJK distance", "[collisions]") {
+  std::vector<Vec2> shape1{Vec2{4, 11}, Vec2{9, 9}, Vec2{4, 5}};
+  std::vector<Vec2> shape2{Vec2{5, 7}, Vec2{12, 7}, Vec2{10, 2}, Vec2{7, 3}};
+  std::vector<Vec2> shape3{Vec2{-4, 11}, Vec2{-9, 9}, Vec2{-4, 5}};
+
+  SECTION("Overlapping shapes") {
+    REQUIRE(collision::distance(shape1, shape2).intersects == true);
+  }
+
+  SECTION("Separated shapes report distance and closest points") {
+    auto separation = collision::distance(shape1, shape3);
+    REQUIRE(separation.intersects == false);
+    REQUIRE(separation.distance == Approx(8));
+    REQUIRE(separation.normal.x == Approx(-1));
+    REQUIRE(separation.closest1.x == Approx(4));
+    REQUIRE(separation.closest2.x == Approx(-4));
+    REQUIRE(separation.closest1.y == Approx(separation.closest2.y));
+    REQUIRE(separation.closest1.y >= 5.f);
+    REQUIRE(separation.closest1.y <= 11.f);
+  }
+
+  SECTION("Vertex against edge") {
+    std::vector<Vec2> diamond{Vec2{32, 70}, Vec2{52, 90}, Vec2{32, 110}, Vec2{12, 90}};
+    auto box = collision::rectToPoints(Vec4{0, 0, 64, 64});
+    auto separation = collision::distance(box, diamond);
+    REQUIRE(separation.distance == Approx(6));
+    REQUIRE(separation.closest1.x == Approx(32));
+    REQUIRE(separation.closest1.y == Approx(64));
+    REQUIRE(separation.closest2 == Vec2(32, 70));
+  }
+
+  SECTION("Matches the distance between rects") {
+    Vec4 rect1{0, 0, 64, 64};
+    for (float x = 70; x < 200; x += 13) {
+      auto separation = collision::distance(collision::rectToPoints(rect1), collision::rectToPoints(Vec4{x, 30, 64, 64}));
+      REQUIRE(separation.distance == Approx(x - 64));
+      REQUIRE(glm::distance(separation.closest1, separation.closest2) == Approx(separation.distance));
+    }
+  }
+}
+
+TEST_CASE("Continuous collisions", "[collisions]") {
+  Vec4 wall{100, 0, 64, 64};
+
+  SECTION("Swept AABB hits the near face") {
+    auto toi = collision::sweptAABB(Vec4{0, 10, 32, 32}, Vec2{100, 0}, wall);
+    REQUIRE(toi.hit);
+    REQUIRE(toi.time == Approx(0.68));
+    REQUIRE(toi.normal == Vec2(1, 0));
+  }
+
+  SECTION("Swept AABB misses and stops short") {
+    REQUIRE_FALSE(collision::sweptAABB(Vec4{0, 80, 32, 32}, Vec2{100, 0}, wall).hit);
+    REQUIRE_FALSE(collision::sweptAABB(Vec4{0, 10, 32, 32}, Vec2{50, 0}, wall).hit);
+    REQUIRE_FALSE(collision::sweptAABB(Vec4{0, 10, 32, 32}, Vec2{-100, 0}, wall).hit);
+  }
+
+  SECTION("Fast bodies don't tunnel") {
+    auto toi = collision::sweptAABB(Vec4{0, 10, 32, 32}, Vec2{1000, 20}, Vec4{500, 0, 8, 64});
+    REQUIRE(toi.hit);
+    REQUIRE(toi.time == Approx(0.468));
+  }
+
+  SECTION("Conservative advancement on polygons") {
+    std::vector<Vec2> triangle{Vec2{0, 0}, Vec2{10, 5}, Vec2{0, 10}};
+    auto wallPoints = collision::rectToPoints(wall);
+
+    auto toi = collision::timeOfImpact(triangle, Vec2{200, 0}, wallPoints);
+    REQUIRE(toi.hit);
+    REQUIRE(toi.time == Approx(0.45).margin(1e-3));
+    REQUIRE(toi.normal.x == Approx(1).margin(1e-3));
+
+    REQUIRE_FALSE(collision::timeOfImpact(triangle, Vec2{0, 200}, wallPoints).hit);
+  }
+}
+
+TEST_CASE("SAT collisions", "[collisions]") {
+  std::vector<Vec2> shape1{Vec2{4, 11}, Vec2{9, 9}, Vec2{4, 5}};
+  std::vector<Vec2> shape2{Vec2{5, 7}, Vec2{12, 7}, Vec2{10, 2}, Vec2{7, 3}};
+  std::vector<Vec2> shape3{Vec2{-4, 11}, Vec2{-9, 9}, Vec2{-4, 5}};
+
+  SECTION("Same answers as GJK + EPA") {
+    REQUIRE(collision::SAT(shape1, shape2).collides == true);
+    REQUIRE(collision::SAT(shape1, shape3).collides == false);
+
+    auto sat = collision::SAT(shape1, shape2);
+    auto gjk = collision::collide(collision::ShapeView{shape1}, collision::ShapeView{shape2});
+    REQUIRE(sat.depth == Approx(gjk.depth).margin(1e-3));
+    REQUIRE(sat.normal.x == Approx(gjk.normal.x).margin(1e-3));
+    REQUIRE(sat.normal.y == Approx(gjk.normal.y).margin(1e-3));
+  }
+
+  SECTION("Every engine agrees on rects") {
+    Vec4 rect1{0, 0, 64, 64};
+    for (float x = -72; x <= 72; x += 9) {
+      for (float y = -72; y <= 72; y += 11) {
+	Vec4 rect2{x, y, 40, 40};
+	auto aabb = collision::collide(collision::Engine::AABB, rect1, rect2);
+	for (auto engine : {collision::Engine::GJK, collision::Engine::SAT}) {
+	  auto contact = collision::collide(engine, rect1, rect2);
+	  REQUIRE(contact.collides == aabb.collides);
+	  REQUIRE(contact.depth == Approx(aabb.depth).margin(1e-3));
+	}
+      }
+    }
+  }
+
+  SECTION("Cached separating axis") {
+    Vec2 axis{0, 0};
+    REQUIRE(collision::SAT(shape1, shape3, axis).collides == false);
+    REQUIRE(glm::length(axis) == Approx(1));
+    REQUIRE(collision::SAT(shape1, shape3, axis).collides == false);
+    REQUIRE(collision::SAT(shape1, shape2, axis).collides == true);
+  }
+}
+
+TEST_CASE("MPR collisions", "[collisions]") {
+  std::vector<Vec2> shape1{Vec2{4, 11}, Vec2{9, 9}, Vec2{4, 5}};
+  std::vector<Vec2> shape2{Vec2{5, 7}, Vec2{12, 7}, Vec2{10, 2}, Vec2{7, 3}};
+  std::vector<Vec2> shape3{Vec2{-4, 11}, Vec2{-9, 9}, Vec2{-4, 5}};
+
+  SECTION("Overlap tests match GJK") {
+    REQUIRE(collision::MPR(shape1, shape2).collides == true);
+    REQUIRE(collision::MPR(shape1, shape3).collides == false);
+    REQUIRE(collision::MPR(shape2, shape3).collides == false);
+  }
+
+  SECTION("Moving shape1 back along the normal separates the shapes") {
+    auto contact = collision::MPR(shape1, shape2);
+    REQUIRE(glm::length(contact.normal) == Approx(1));
+    REQUIRE(contact.depth >= collision::collide(collision::ShapeView{shape1}, collision::ShapeView{shape2}).depth - 1e-3f);
+
+    auto moved = shape1;
+    for (auto& p : moved) p -= contact.normal * (contact.depth + 1e-2f);
+    REQUIRE_FALSE(collision::GJK(moved, shape2).second);
+  }
+
+  SECTION("Rects overlap like AABB") {
+    Vec4 rect1{0, 0, 64, 64};
+    for (float x = -72; x <= 72; x += 9) {
+      for (float y = -72; y <= 72; y += 11) {
+	Vec4 rect2{x, y, 40, 40};
+	auto aabb = collision::AABB(rect1, rect2);
+	auto mpr = collision::collide(collision::Engine::MPR, rect1, rect2);
+	REQUIRE(mpr.collides == aabb.collides);
+	if (mpr.collides) {
+	  REQUIRE(mpr.depth >= aabb.depth - 1e-3f);
+	}
+      }
+    }
+  }
+}
+
+TEST_CASE("Contact manifolds", "[collisions]") {
+  Vec4 box{0, 0, 64, 64};
+
+  SECTION("Resting box gets two points along the shared face") {
+    Vec4 other{16, 60, 64, 64};
+    auto points1 = collision::rectToPoints(box);
+    auto points2 = collision::rectToPoints(other);
+    auto contact = collision::collide(collision::Engine::SAT, box, other);
+    auto manifold = collision::manifold(points1, points2, contact);
+
+    REQUIRE(manifold.count == 2);
+    REQUIRE(manifold.normal == Vec2(0, 1));
+    for (std::size_t i = 0; i < manifold.count; ++i) {
+      REQUIRE(manifold.points[i].depth == Approx(4));
+      REQUIRE(manifold.points[i].position.x >= 16.f);
+      REQUIRE(manifold.points[i].position.x <= 64.f);
+    }
+  }
+
+  SECTION("Corner hit gets a single point") {
+    std::vector<Vec2> diamond{Vec2{32, 60}, Vec2{52, 80}, Vec2{32, 100}, Vec2{12, 80}};
+    auto points1 = collision::rectToPoints(box);
+    auto contact = collision::SAT(points1, diamond);
+    auto manifold = collision::manifold(points1, diamond, contact);
+
+    REQUIRE(manifold.count == 1);
+    REQUIRE(manifold.points[0].position == Vec2(32, 60));
+    REQUIRE(manifold.points[0].depth == Approx(4));
+  }
+
+  SECTION("Persistent manifolds keep their points") {
+    collision::ManifoldCache cache;
+    auto points1 = collision::rectToPoints(box);
+
+    for (int frame = 0; frame < 3; ++frame) {
+      cache.beginFrame();
+      Vec4 other{16.f + static_cast<float>(frame) * 0.5f, 60, 64, 64};
+      auto points2 = collision::rectToPoints(other);
+      auto fresh = collision::manifold(points1, points2, collision::SAT(points1, points2));
+      auto const& kept = cache.update(0, 1, fresh);
+      REQUIRE(kept.count == 2);
+      REQUIRE(kept.points[0].age == static_cast<std::size_t>(frame));
+      cache.endFrame();
+    }
+
+    cache.beginFrame();
+    cache.endFrame();
+    REQUIRE(cache.size() == 0);
+  }
+}
+
+TEST_CASE("Batched AABB overlap", "[collisions]") {
+  Vec4 query{30, 30, 64, 64};
+  collision::RectSoA rects;
+  for (int i = 0; i < 37; ++i) {
+    rects.push(Vec4{(i % 7) * 24 - 40, (i / 7) * 24 - 40, 32, 32});
+  }
+  rects.push(Vec4{94, 30, 64, 64}); // touching
+
+  std::vector<std::uint8_t> expected(rects.size());
+  std::vector<std::uint8_t> out(rects.size());
+
+  for (std::size_t i = 0; i < rects.size(); ++i) {
+    Vec4 rect{rects.xs[i], rects.ys[i], rects.ws[i], rects.hs[i]};
+    expected[i] = collision::AABB(query, rect).collides ? 1 : 0;
+  }
+
+  SECTION("Dispatched kernel") {
+    collision::overlapBatch(query, rects, out.data());
+    REQUIRE(out == expected);
+  }
+
+  SECTION("Scalar kernel") {
+    collision::detail::overlapBatchScalar(query, rects.xs.data(), rects.ys.data(), rects.ws.data(), rects.hs.data(),
+					  rects.size(), out.data());
+    REQUIRE(out == expected);
+  }
+
+#ifdef SOKOBAN_HAS_SSE2
+  SECTION("SSE2 kernel") {
+    collision::detail::overlapBatchSSE2(query, rects.xs.data(), rects.ys.data(), rects.ws.data(), rects.hs.data(),
+					rects.size(), out.data());
+    REQUIRE(out == expected);
+  }
+#endif
+
+#ifdef SOKOBAN_HAS_AVX2
+  if (__builtin_cpu_supports("avx2")) {
+    SECTION("AVX2 kernel") {
+      collision::detail::overlapBatchAVX2(query, rects.xs.data(), rects.ys.data(), rects.ws.data(), rects.hs.data(),
+					  rects.size(), out.data());
+      REQUIRE(out == expected);
+    }
+  }
+#endif
+}
+
+TEST_CASE("Merged wall colliders", "[broadphase]") {
+  Level level{10, 9,
+	      "2222222222"
+	      "2000000002"
+	      "2000000002"
+	      "2000304002"
+	      "2010304002"
+	      "2000000002"
+	      "2000000002"
+	      "2000000002"
+	      "2222222222"};
+
+  REQUIRE(level.wallTiles == 34);
+  REQUIRE(level.mergedWalls == 4);
+  REQUIRE(level.colliders.size() == 4 + 4);
+  REQUIRE(level.colliders[0].rect == Vec4(0, 0, 640, 64));
+
+  auto coveredTiles = [](std::vector<GameObject> const& objects) {
+    std::vector<Vec2> tiles;
+    for (auto const& obj : objects) {
+      if (obj.tex != TextureType::Wall) continue;
+      for (float y = obj.rect.y; y < obj.rect.y + obj.rect.w; y += 64) {
+	for (float x = obj.rect.x; x < obj.rect.x + obj.rect.z; x += 64) {
+	  tiles.emplace_back(x, y);
+	}
+      }
+    }
+    std::sort(tiles.begin(), tiles.end(), [](Vec2 a, Vec2 b) { return a.y < b.y || (a.y == b.y && a.x < b.x); });
+    return tiles;
+  };
+
+  SECTION("Merged rects cover the same tiles without overlapping") {
+    REQUIRE(coveredTiles(level.colliders) == coveredTiles(level.objects));
+  }
+
+  SECTION("Blocks and holes") {
+    Level maze{6, 5,
+	       "222222"
+	       "220022"
+	       "222022"
+	       "200002"
+	       "222222"};
+    REQUIRE(maze.wallTiles == 23);
+    REQUIRE(maze.mergedWalls < maze.wallTiles / 2);
+    REQUIRE(coveredTiles(maze.colliders) == coveredTiles(maze.objects));
+  }
+
+  SECTION("Merging again gives the same stats") {
+    level.mergeWalls();
+    REQUIRE(level.wallTiles == 34);
+    REQUIRE(level.mergedWalls == 4);
+    REQUIRE(level.colliders.size() == 4 + 4);
+  }
+}
+
+TEST_CASE("Uniform grid broadphase", "[broadphase]") {
+  Level level{5, 4,
+	      "22222"
+	      "20302"
+	      "20102"
+	      "22222"};
+  auto grid = broadphase::buildGrid(level);
+  std::vector<std::size_t> candidates;
+
+  SECTION("Only objects in the cells under the query are returned") {
+    grid.query(Vec4{64, 64, 64, 64}, candidates);
+    REQUIRE(candidates.empty());
+
+    grid.query(Vec4{96, 96, 64, 64}, candidates);
+    REQUIRE(candidates.size() == 1);
+    REQUIRE(level.objects[candidates[0]].tex == TextureType::Box);
+
+    candidates.clear();
+    grid.query(Vec4{32, 32, 64, 64}, candidates);
+    REQUIRE(candidates.size() == 3);
+  }
+
+  SECTION("Moving an object updates its cells") {
+    std::size_t box = 0;
+    while (level.objects[box].tex != TextureType::Box) ++box;
+    Vec4 from = level.objects[box].rect;
+    Vec4 to{from.x, from.y + 40, from.z, from.w};
+
+    grid.move(box, from, to);
+
+    grid.query(Vec4{128, 64, 64, 64}, candidates);
+    REQUIRE(candidates.size() == 1);
+    candidates.clear();
+    grid.query(Vec4{128, 128, 64, 64}, candidates);
+    REQUIRE(std::count(candidates.begin(), candidates.end(), box) == 1);
+
+    grid.remove(box, to);
+    candidates.clear();
+    grid.query(Vec4{128, 64, 64, 128}, candidates);
+    REQUIRE(std::count(candidates.begin(), candidates.end(), box) == 0);
+  }
+}
+
+TEST_CASE("Sweep and prune broadphase", "[broadphase]") {
+  broadphase::SweepAndPrune sap;
+  std::vector<std::pair<std::size_t, std::size_t>> pairs;
+
+  sap.insert(0, Vec4{0, 0, 64, 64});
+  sap.insert(1, Vec4{200, 0, 64, 64});
+  sap.insert(2, Vec4{32, 100, 64, 64});
+  sap.insert(3, Vec4{40, 40, 64, 64});
+
+  sap.pairs(pairs);
+  REQUIRE(pairs.size() == 2);
+  REQUIRE(std::count(pairs.begin(), pairs.end(), std::make_pair(std::size_t{0}, std::size_t{3})) == 1);
+  REQUIRE(std::count(pairs.begin(), pairs.end(), std::make_pair(std::size_t{2}, std::size_t{3})) == 1);
+
+  SECTION("Moving bodies reorders the sweep") {
+    sap.update(1, Vec4{10, 10, 20, 20});
+    sap.update(3, Vec4{300, 40, 64, 64});
+    pairs.clear();
+    sap.pairs(pairs);
+    REQUIRE(pairs.size() == 1);
+    REQUIRE(pairs[0] == std::make_pair(std::size_t{0}, std::size_t{1}));
+  }
+
+  SECTION("Removed bodies stop pairing") {
+    sap.remove(3);
+    pairs.clear();
+    sap.pairs(pairs);
+    REQUIRE(pairs.empty());
+    REQUIRE(sap.size() == 3);
+
+    // updating a removed or unknown body leaves the order alone
+    sap.update(3, Vec4{-100, 0, 64, 64});
+    sap.update(42, Vec4{0, 0, 64, 64});
+    REQUIRE(sap.size() == 3);
+    std::vector<std::size_t> found;
+    sap.query(0, found);
+    REQUIRE(found.empty());
+    sap.query(2, found);
+    REQUIRE(found.empty());
+    pairs.clear();
+    sap.pairs(pairs);
+    REQUIRE(pairs.empty());
+  }
+
+  SECTION("Single body queries match the pairs") {
+    std::vector<std::size_t> found;
+    sap.query(3, found);
+    std::sort(found.begin(), found.end());
+    REQUIRE(found == std::vector<std::size_t>{0, 2});
+
+    found.clear();
+    sap.query(1, found);
+    REQUIRE(found.empty());
+
+    // a wide body far to the left still reaches the queried one
+    sap.insert(4, Vec4{-500, 150, 600, 10});
+    found.clear();
+    sap.query(2, found);
+    std::sort(found.begin(), found.end());
+    REQUIRE(found == std::vector<std::size_t>{3, 4});
+
+    sap.update(4, Vec4{-500, 150, 10, 10});
+    found.clear();
+    sap.query(2, found);
+    REQUIRE(found == std::vector<std::size_t>{3});
+  }
+}
+
+TEST_CASE("Dynamic AABB tree", "[broadphase]") {
+  broadphase::AABBTree tree{4.f};
+  std::vector<Vec4> rects;
+  std::vector<int> proxies;
+  for (int i = 0; i < 200; ++i) {
+    rects.push_back(Vec4{(i * 37) % 640, (i * 53) % 480, 16 + i % 48, 16 + (i * 7) % 48});
+    proxies.push_back(tree.insert(static_cast<std::size_t>(i), rects.back()));
+  }
+
+  auto matchesBruteForce = [&](Vec4 query) {
+    std::vector<std::size_t> found;
+    tree.query(query, found);
+    for (std::size_t i = 0; i < rects.size(); ++i) {
+      bool overlaps = collision::AABB(query, rects[i]).collides;
+      bool reported = std::count(found.begin(), found.end(), i) == 1;
+      if (overlaps && !reported) return false;
+    }
+    return true;
+  };
+
+  REQUIRE(tree.height() < 20);
+  REQUIRE(matchesBruteForce(Vec4{100, 100, 64, 64}));
+  REQUIRE(matchesBruteForce(Vec4{0, 0, 640, 480}));
+
+  SECTION("Small moves stay inside the fat rect") {
+    Vec4 moved{rects[0].x + 2, rects[0].y - 2, rects[0].z, rects[0].w};
+    REQUIRE(tree.move(proxies[0], moved) == false);
+    rects[0] = moved;
+    REQUIRE(matchesBruteForce(moved));
+  }
+
+  SECTION("Large moves and removals keep queries exact") {
+    for (std::size_t i = 0; i < rects.size(); i += 3) {
+      rects[i].x += 150;
+      REQUIRE(tree.move(proxies[i], rects[i]) == true);
+    }
+    for (std::size_t i = 1; i < rects.size(); i += 5) {
+      tree.remove(proxies[i]);
+      rects[i] = Vec4{-1000, -1000, 1, 1};
+    }
+    REQUIRE(tree.height() < 20);
+    for (float x = 0; x < 800; x += 50) {
+      REQUIRE(matchesBruteForce(Vec4{x, x / 2, 80, 80}));
+    }
+  }
+}
+
+TEST_CASE("Parallel narrowphase", "[collisions]") {
+  std::vector<Vec4> rects;
+  std::vector<std::vector<Vec2>> polygons;
+  for (int i = 0; i < 300; ++i) {
+    rects.push_back(Vec4{(i * 37) % 400, (i * 53) % 300, 16 + i % 48, 16 + (i * 7) % 48});
+    auto points = collision::rectToPoints(rects.back());
+    polygons.emplace_back(points.begin(), points.end());
+  }
+  std::vector<collision::ShapeView> shapes(polygons.begin(), polygons.end());
+
+  collision::ParallelNarrowphase::Pairs pairs;
+  for (std::size_t i = 0; i < rects.size(); ++i) {
+    for (std::size_t j = i + 1; j < rects.size(); ++j) {
+      pairs.emplace_back(i, j);
+    }
+  }
+
+  auto sameResults = [](std::vector<collision::PairContact> const& a, std::vector<collision::PairContact> const& b) {
+    if (a.size() != b.size()) return false;
+    for (std::size_t i = 0; i < a.size(); ++i) {
+      if (a[i].first != b[i].first || a[i].second != b[i].second) return false;
+      if (a[i].contact.normal != b[i].contact.normal || a[i].contact.depth != b[i].contact.depth) return false;
+    }
+    return true;
+  };
+
+  ThreadPool serialPool{1};
+  ThreadPool pool{4};
+  collision::ParallelNarrowphase serial{serialPool};
+  collision::ParallelNarrowphase parallel{pool, 16};
+
+  SECTION("Rects match a serial run in the same order") {
+    std::vector<collision::PairContact> expected;
+    for (auto& pair : pairs) {
+      auto contact = collision::collide(collision::Engine::AABB, rects[pair.first], rects[pair.second]);
+      if (contact.collides) expected.push_back({pair.first, pair.second, contact});
+    }
+    REQUIRE(!expected.empty());
+
+    for (int run = 0; run < 5; ++run) {
+      std::vector<collision::PairContact> found;
+      parallel.collide(collision::Engine::AABB, rects, pairs, found);
+      REQUIRE(sameResults(found, expected));
+    }
+  }
+
+  SECTION("GJK + EPA on shapes") {
+    std::vector<collision::PairContact> expected;
+    std::vector<collision::PairContact> found;
+    serial.collide(shapes, pairs, expected);
+    parallel.collide(shapes, pairs, found);
+    REQUIRE(!expected.empty());
+    REQUIRE(sameResults(found, expected));
+  }
+
+  SECTION("Empty pair list") {
+    std::vector<collision::PairContact> found;
+    parallel.collide(collision::Engine::AABB, rects, {}, found);
+    REQUIRE(found.empty());
+  }
+}
+
+TEST_CASE("Tile occupancy grid", "[tiles]") {
+  Level level{6, 3,
+	      "222222"
+	      "213042"
+	      "222222"};
+  TileGrid tiles{level};
+
+  REQUIRE(tiles.at(2, 1) == TileGrid::Box);
+  REQUIRE(tiles.at(4, 1) == TileGrid::Goal);
+  REQUIRE(tiles.at(0, 0) == TileGrid::Wall);
+  REQUIRE(tiles.playerCell() == tiles.index(1, 1));
+  REQUIRE_FALSE(tiles.solved());
+
+  SECTION("Walls block the player") {
+    REQUIRE(tiles.move(0, -1).move == TileGrid::Move::Blocked);
+    REQUIRE(tiles.move(-1, 0).move == TileGrid::Move::Blocked);
+    REQUIRE(tiles.playerCell() == tiles.index(1, 1));
+  }
+
+  SECTION("Boxes are pushed into free cells only") {
+    auto result = tiles.move(1, 0);
+    REQUIRE(result.move == TileGrid::Move::Pushed);
+    REQUIRE(result.boxFrom == tiles.index(2, 1));
+    REQUIRE(result.boxTo == tiles.index(3, 1));
+    REQUIRE(tiles.playerCell() == tiles.index(2, 1));
+
+    REQUIRE(tiles.move(1, 0).move == TileGrid::Move::Pushed);
+    REQUIRE(tiles.at(4, 1) == (TileGrid::Box | TileGrid::Goal));
+    REQUIRE(tiles.solved());
+
+    // wall behind the box
+    REQUIRE(tiles.move(1, 0).move == TileGrid::Move::Blocked);
+    REQUIRE(tiles.playerCell() == tiles.index(3, 1));
+
+    REQUIRE(tiles.move(-1, 0).move == TileGrid::Move::Walked);
+  }
+
+  SECTION("Two boxes in a row don't move") {
+    Level row{6, 3,
+	      "222222"
+	      "213302"
+	      "222222"};
+    TileGrid blocked{row};
+    REQUIRE(blocked.move(1, 0).move == TileGrid::Move::Blocked);
+  }
+}
+
+TEST_CASE("Ray casts", "[collisions]") {
+  Level level{8, 6,
+	      "22222222"
+	      "20000002"
+	      "20020302"
+	      "20000002"
+	      "21000002"
+	      "22222222"};
+  TileGrid tiles{level};
+
+  SECTION("DDA stops at the first blocking tile") {
+    auto hit = collision::castRay(tiles, Vec2{96, 96}, Vec2{480, 96});
+    REQUIRE(hit.hit);
+    REQUIRE(hit.point.x == Approx(448));
+    REQUIRE(hit.normal == Vec2(-1, 0));
+    REQUIRE(hit.cell == tiles.index(7, 1));
+
+    hit = collision::castRay(tiles, Vec2{96, 160}, Vec2{480, 160});
+    REQUIRE(hit.cell == tiles.index(3, 2));
+    REQUIRE(hit.fraction == Approx(96.f / 384.f));
+
+    // the box only blocks when asked to
+    hit = collision::castRay(tiles, Vec2{290, 160}, Vec2{460, 160}, TileGrid::Wall);
+    REQUIRE(hit.hit);
+    REQUIRE(hit.cell == tiles.index(7, 2));
+    REQUIRE(hit.fraction == Approx(158.f / 170.f));
+    REQUIRE_FALSE(collision::castRay(tiles, Vec2{290, 160}, Vec2{440, 160}, TileGrid::Wall).hit);
+  }
+
+  SECTION("Line of sight") {
+    REQUIRE(collision::lineOfSight(tiles, Vec2{96, 96}, Vec2{416, 96}));
+    REQUIRE_FALSE(collision::lineOfSight(tiles, Vec2{96, 160}, Vec2{416, 160}));
+    REQUIRE(collision::lineOfSight(tiles, Vec2{96, 200}, Vec2{120, 280}));
+    REQUIRE_FALSE(collision::lineOfSight(tiles, Vec2{96, 96}, Vec2{-50, 96}));
+  }
+
+  SECTION("DDA agrees with GJK casts against every tile") {
+    std::vector<Vec4> blocking;
+    for (auto const& obj : level.objects) {
+      if (obj.tex == TextureType::Wall || obj.tex == TextureType::Box) blocking.push_back(obj.rect);
+    }
+
+    for (int i = 0; i < 200; ++i) {
+      Vec2 from{70 + (i * 37) % 370, 70 + (i * 53) % 240};
+      Vec2 to{70 + (i * 91) % 370, 70 + (i * 17) % 240};
+      if (tiles.at(static_cast<std::size_t>(from.x) / 64, static_cast<std::size_t>(from.y) / 64) != TileGrid::Empty)
+	continue;
+
+      collision::RayHit nearest;
+      for (auto rect : blocking) {
+	auto hit = collision::castRay(collision::rectToPoints(rect), from, to);
+	if (hit.hit && hit.fraction < nearest.fraction) nearest = hit;
+      }
+
+      auto grid = collision::castRay(tiles, from, to);
+      REQUIRE(grid.hit == nearest.hit);
+      if (grid.hit) {
+	REQUIRE(glm::length(grid.point - nearest.point) < 0.1f);
+      }
+    }
+  }
+}
+
+TEST_CASE("Sleeping islands", "[physics]") {
+  physics::SleepSystem sleep{0.1f, 10.f};
+  sleep.resize(5);
+  sleep.setStatic(0, true); // a wall
+
+  auto step = [&](int count) {
+    for (int i = 0; i < count; ++i) sleep.solveIslands(1.f);
+  };
+
+  SECTION("Resting bodies fall asleep after the delay") {
+    step(9);
+    REQUIRE(sleep.awakeCount() == 4);
+    step(1);
+    REQUIRE(sleep.awakeCount() == 0);
+    REQUIRE_FALSE(sleep.isAwake(0));
+
+    sleep.update(2, 0.05f);
+    step(1);
+    REQUIRE(sleep.awakeCount() == 0);
+
+    sleep.update(2, 1.f);
+    step(1);
+    REQUIRE(sleep.isAwake(2));
+    REQUIRE(sleep.awakeCount() == 1);
+  }
+
+  SECTION("Contacts wake the whole island") {
+    step(20);
+    REQUIRE(sleep.awakeCount() == 0);
+
+    // 1 moves and touches 2, which touches 3; 4 is alone
+    sleep.wake(1);
+    sleep.addContact(1, 2);
+    sleep.addContact(2, 3);
+    step(1);
+    REQUIRE(sleep.islandCount() == 2);
+    REQUIRE(sleep.isAwake(2));
+    REQUIRE(sleep.isAwake(3));
+    REQUIRE_FALSE(sleep.isAwake(4));
+    REQUIRE(sleep.awakeCount() == 3);
+
+    // the island waits for its last mover
+    for (int i = 0; i < 5; ++i) {
+      sleep.update(1, 1.f);
+      sleep.addContact(1, 2);
+      sleep.addContact(2, 3);
+      step(1);
+    }
+    step(9);
+    REQUIRE(sleep.isAwake(3));
+    step(1);
+    REQUIRE(sleep.awakeCount() == 0);
+  }
+
+  SECTION("Static bodies don't join islands") {
+    sleep.addContact(1, 0);
+    sleep.addContact(0, 2);
+    sleep.wake(1);
+    step(1);
+    REQUIRE(sleep.islandCount() == 4);
+    step(10);
+    REQUIRE(sleep.awakeCount() == 0);
+  }
+}
+
+TEST_CASE("Player steps", "[physics]") {
+  GameObject player{TextureType::Player};
+  player.rect = Vec4{100, 100, 64, 64};
+
+  Vec2 move = player.displacement(Vec2{1, 0}, 1.f);
+  REQUIRE(move.x > 0.f);
+  REQUIRE(move.y == 0.f);
+  REQUIRE(player.velocity.x > 0.f);
+
+  SECTION("No input, no move") {
+    // the continuous mode sweeps by the displacement, the sliced mode applies it
+    REQUIRE(player.displacement(Vec2{0, 0}, 1.f) == Vec2(0, 0));
+    player.applyForce(Vec2{0, 0}, 1.f);
+    REQUIRE(player.rect == Vec4(100, 100, 64, 64));
+    REQUIRE(player.velocity.x > 0.f);
+  }
+}
+
+TEST_CASE("Collision layers", "[collisions]") {
+  GameObject player(TextureType::Player);
+  GameObject wall(TextureType::Wall);
+  GameObject box(TextureType::Box);
+  GameObject goal(TextureType::Goal);
+
+  REQUIRE(shouldCollide(player, wall));
+  REQUIRE(shouldCollide(player, box));
+  REQUIRE(shouldCollide(box, wall));
+  REQUIRE_FALSE(shouldCollide(player, goal));
+  REQUIRE_FALSE(shouldCollide(box, goal));
+
+  SECTION("Both masks have to accept the other category") {
+    box.mask = layers::wall;
+    REQUIRE_FALSE(shouldCollide(player, box));
+    REQUIRE(shouldCollide(box, wall));
+  }
+
+  SECTION("Triggers") {
+    GameObject trigger(TextureType::Test);
+    trigger.category = layers::trigger;
+    trigger.mask = layers::player;
+    REQUIRE(isTrigger(trigger));
+    REQUIRE(shouldCollide(player, trigger));
+    REQUIRE_FALSE(shouldCollide(box, trigger));
+  }
+
+  SECTION("Goals are loaded but filtered out") {
+    Level level{4, 3,
+		"2222"
+		"2142"
+		"2222"};
+    REQUIRE(level.goals.size() == 1);
+    auto goals = std::count_if(level.objects.begin(), level.objects.end(), [&](GameObject const& obj) {
+	return obj.tex == TextureType::Goal && !shouldCollide(player, obj);
+      });
+    REQUIRE(goals == 1);
+  }
+
+  SECTION("Goals come before boxes so boxes are drawn over them") {
+    Level level{6, 3,
+		"222222"
+		"231042"
+		"222222"};
+    REQUIRE(level.objects.front().tex == TextureType::Goal);
+    auto firstBox = std::find_if(level.objects.begin(), level.objects.end(), [](GameObject const& obj) {
+	return obj.tex == TextureType::Box;
+      });
+    REQUIRE(firstBox != level.objects.end());
+    REQUIRE(firstBox->rect.x < level.objects.front().rect.x);
+  }
+
+  SECTION("Overlap-only queries agree with the full ones") {
+    Vec4 a{0, 0, 64, 64};
+    for (float x = -80; x <= 80; x += 8) {
+      Vec4 b{x, x / 2, 64, 64};
+      for (auto engine : {collision::Engine::AABB, collision::Engine::GJK, collision::Engine::SAT, collision::Engine::MPR}) {
+	REQUIRE(collision::overlaps(engine, a, b) == collision::AABB(a, b).collides);
+      }
+    }
+  }
+}
+
+TEST_CASE("Sokoban solver", "[solver]") {
+  // replays LURD moves with the game rules
+  auto play = [](Level const& level, std::string const& moves) {
+    TileGrid tiles{level};
+    for (char c : moves) {
+      int dx = c == 'l' || c == 'L' ? -1 : c == 'r' || c == 'R' ? 1 : 0;
+      int dy = c == 'u' || c == 'U' ? -1 : c == 'd' || c == 'D' ? 1 : 0;
+      auto result = tiles.move(dx, dy);
+      bool push = c >= 'A' && c <= 'Z';
+      if (result.move != (push ? TileGrid::Move::Pushed : TileGrid::Move::Walked)) return false;
+    }
+    return tiles.solved();
+  };
+
+  SECTION("Single push") {
+    Level level{5, 3,
+		"22222"
+		"21342"
+		"22222"};
+    auto solution = solver::Solver{level}.solve();
+    REQUIRE(solution.solved);
+    REQUIRE(solution.moves == "R");
+    REQUIRE(solution.pushes == 1);
+  }
+
+  SECTION("The game level") {
+    Level level{10, 9,
+		"2222222222"
+		"2000000002"
+		"2000000002"
+		"2000304002"
+		"2010304002"
+		"2000000002"
+		"2000000002"
+		"2000000002"
+		"2222222222"};
+    auto solution = solver::Solver{level}.solve();
+    REQUIRE(solution.solved);
+    REQUIRE(solution.pushes == 4);
+    REQUIRE(play(level, solution.moves));
+    REQUIRE(solution.stats.expanded > 0);
+    REQUIRE(solution.stats.peakBytes > 0);
+  }
+
+  SECTION("Walking around boxes and pushing in several directions") {
+    Level level{7, 7,
+		"2222222"
+		"2000002"
+		"2030302"
+		"2004002"
+		"2210242"
+		"2000002"
+		"2222222"};
+    auto solution = solver::Solver{level}.solve();
+    REQUIRE(solution.solved);
+    REQUIRE(play(level, solution.moves));
+  }
+
+  SECTION("Unsolvable levels are proven so") {
+    // box in a corner
+    Level corner{5, 4,
+		 "22222"
+		 "23002"
+		 "20142"
+		 "22222"};
+    auto solution = solver::Solver{corner}.solve();
+    REQUIRE_FALSE(solution.solved);
+    REQUIRE(solution.exhausted);
+
+    // the only way to the goal is blocked by the second box
+    Level stuck{7, 3,
+		"2222222"
+		"2133042"
+		"2222222"};
+    solution = solver::Solver{stuck}.solve();
+    REQUIRE_FALSE(solution.solved);
+    REQUIRE(solution.exhausted);
+  }
+
+  SECTION("Search limit") {
+    Level level{10, 9,
+		"2222222222"
+		"2000000002"
+		"2000000002"
+		"2000304002"
+		"2010304002"
+		"2000000002"
+		"2000000002"
+		"2000000002"
+		"2222222222"};
+    auto solution = solver::Solver{level}.solve(0);
+    REQUIRE_FALSE(solution.solved);
+    REQUIRE_FALSE(solution.exhausted);
+  }
+}
+
+TEST_CASE("Packed solver states", "[solver]") {
+  Level level{10, 9,
+	      "2222222222"
+	      "2000000002"
+	      "2000000002"
+	      "2000304002"
+	      "2010304002"
+	      "2000000002"
+	      "2000000002"
+	      "2000000002"
+	      "2222222222"};
+  TileGrid tiles{level};
+  solver::StateCodec codec{tiles};
+
+  SECTION("Bits cover the interior cells") {
+    REQUIRE(codec.cells() == 56);
+    REQUIRE(codec.words() == 2);
+    REQUIRE(codec.bytesPerState() == 16);
+    REQUIRE(codec.serializedBytes() == 11);
+    REQUIRE_FALSE(codec.interior(0));
+    REQUIRE(codec.interior(tiles.index(1, 1)));
+    REQUIRE(solver::Solver{level}.solve().stats.bytesPerState == 16);
+  }
+
+  SECTION("Pack and unpack") {
+    std::vector<std::size_t> boxes{tiles.index(4, 4), tiles.index(4, 3)};
+    auto state = codec.pack(boxes, tiles.index(1, 1));
+    std::sort(boxes.begin(), boxes.end());
+    REQUIRE(codec.boxes(state) == boxes);
+    REQUIRE(codec.player(state) == tiles.index(1, 1));
+
+    // box order doesn't matter
+    std::reverse(boxes.begin(), boxes.end());
+    auto same = codec.pack(boxes, tiles.index(1, 1));
+    REQUIRE(state == same);
+    REQUIRE(solver::PackedStateHash{}(state) == solver::PackedStateHash{}(same));
+    REQUIRE(state != codec.pack(boxes, tiles.index(2, 1)));
+  }
+
+  SECTION("Serialization round trip") {
+    auto state = codec.pack({tiles.index(4, 3), tiles.index(8, 7)}, tiles.index(2, 5));
+    auto bytes = codec.serialize(state);
+    REQUIRE(bytes.size() == codec.serializedBytes());
+
+    solver::PackedState read;
+    REQUIRE(codec.deserialize(bytes, read));
+    REQUIRE(read == state);
+
+    REQUIRE_FALSE(codec.deserialize(bytes.substr(1), read));
+    bytes[7] = '\xff'; // player past the last interior cell
+    REQUIRE_FALSE(codec.deserialize(bytes, read));
+  }
+
+  SECTION("Player positions in the same area give the same state") {
+    auto start = solver::Solver{level}.startState();
+    tiles.move(0, -1);
+    tiles.move(1, 0);
+    REQUIRE(solver::Solver{tiles}.startState() == start);
+    REQUIRE(codec.player(start) == tiles.index(1, 1));
+  }
+
+  SECTION("Each state is stored once") {
+    solver::StateTable table{codec.words()};
+    auto a = codec.pack({tiles.index(4, 3)}, tiles.index(1, 1));
+    auto b = codec.pack({tiles.index(4, 4)}, tiles.index(1, 1));
+    REQUIRE(table.insert(a.words.data()) == std::make_pair(std::size_t{0}, true));
+    REQUIRE(table.insert(b.words.data()) == std::make_pair(std::size_t{1}, true));
+    REQUIRE(table.insert(a.words.data()) == std::make_pair(std::size_t{0}, false));
+    REQUIRE(table.size() == 2);
+    REQUIRE(std::equal(a.words.begin(), a.words.end(), table[0]));
+  }
+}
+
+TEST_CASE("AABB against GJK", "[.][benchmark]") {
+  std::vector<Vec2> shape1{Vec2{4, 11}, Vec2{9, 9}, Vec2{4, 5}};
+  std::vector<Vec2> shape2{Vec2{5, 7}, Vec2{12, 7}, Vec2{10, 2}, Vec2{7, 3}};
+  Vec4 rect1 = collision::boundingRect(shape1);
+  Vec4 rect2 = collision::boundingRect(shape2);
+  constexpr int queries = 100000;
+  float total = 0;
+
+  BENCHMARK("GJK + EPA on rects") {
+    for (int i = 0; i < queries; ++i) {
+      auto res = collision::GJK(rect1, rect2);
+      auto points1 = collision::rectToPoints(rect1);
+      auto points2 = collision::rectToPoints(rect2);
+      total += collision::EPA(points1, points2, res.first).depth;
+    }
+  }
+
+  BENCHMARK("AABB on rects") {
+    for (int i = 0; i < queries; ++i) {
+      total += collision::AABB(rect1, rect2).depth;
+    }
+  }
+
+  REQUIRE(total > 0);
+}
+
+TEST_CASE("SAT against GJK", "[.][benchmark]") {
+  std::vector<Vec2> shape1{Vec2{4, 11}, Vec2{9, 9}, Vec2{4, 5}};
+  std::vector<Vec2> shape2{Vec2{5, 7}, Vec2{12, 7}, Vec2{10, 2}, Vec2{7, 3}};
+  std::vector<Vec2> shape3{Vec2{-4, 11}, Vec2{-9, 9}, Vec2{-4, 5}};
+  constexpr int queries = 100000;
+  float total = 0;
+
+  for (auto engine : {collision::Engine::GJK, collision::Engine::SAT}) {
+    BENCHMARK(engine == collision::Engine::GJK ? "GJK + EPA on polygons" : "SAT on polygons") {
+      for (int i = 0; i < queries; ++i) {
+	auto overlapping = engine == collision::Engine::GJK ? collision::collide(collision::ShapeView{shape1}, collision::ShapeView{shape2})
+	  : collision::SAT(shape1, shape2);
+	auto apart = engine == collision::Engine::GJK ? collision::collide(collision::ShapeView{shape1}, collision::ShapeView{shape3})
+	  : collision::SAT(shape1, shape3);
+	total += overlapping.depth + apart.depth;
+      }
+    }
+  }
+
+  REQUIRE(total > 0);
 }